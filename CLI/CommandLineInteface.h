@@ -15,14 +15,18 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
+#include <algorithm>
+#include <iomanip>
 #include "SpinCompiler/Types/CompilerSettings.h"
 #include "SpinCompiler/Generator/Compiler.h"
 #include "SpinCompiler/Types/DefaultFileHandler.h"
+#include "SpinCompiler/Types/LibraryPackFileHandler.h"
 #include "CLI/HtmlFiles.h"
 
 
 struct CommandLineInterface {
-    CommandLineInterface():m_quiet(false) {}
+    CommandLineInterface():m_quiet(false),m_writeIfChanged(false),m_stats(false) {}
     static void banner() {
         std::cerr<<"Propeller Spin/PASM Compiler \'OpenSpin\' (c)2012-2018 Parallax Inc. DBA Parallax Semiconductor."<<std::endl;
         std::cerr<<"Adapted from Chip Gracey's x86 asm code by Roy Eltham"<<std::endl;
@@ -35,7 +39,7 @@ struct CommandLineInterface {
         banner();
         std::cerr << "usage: openspin" <<std::endl;
         std::cerr << "    [ -h ]                                display this help"<<std::endl;
-        std::cerr << "    [ -L or -I <path> ]                   add a directory to the include path"<<std::endl;
+        std::cerr << "    [ -L or -I <path> ]                   add a directory or library pack to the include path"<<std::endl;
         std::cerr << "    [ -o <path> ]                         output filename"<<std::endl;
         std::cerr << "    [ -b ]                                output binary file format"<<std::endl;
         std::cerr << "    [ -e ]                                output eeprom file format"<<std::endl;
@@ -51,7 +55,15 @@ struct CommandLineInterface {
         std::cerr << "    [ -M <size> ]                         size of eeprom (up to 16777216 bytes)"<<std::endl;
         //std::cerr << "    [ -s ]                 dump PUB & CON symbol information for top object"<<std::endl;
         std::cerr << "    [ -u ]                                enable unused method elimination"<<std::endl;
+        std::cerr << "    [ -O0 | -O1 | -O2 | -Os ]             optimization level, -O0 (default) is byte-exact to the Propeller Tool"<<std::endl;
+        std::cerr << "                                          -Os currently runs the same passes as -O1"<<std::endl;
+        std::cerr << "    [ --stats ]                           print timing and size delta of each optimization pass"<<std::endl;
+        std::cerr << "    [ --strict ]                          report errors in unused methods too (parsed lazily with -u)"<<std::endl;
+        std::cerr << "    [ --max-errors <count> ]              report up to count errors before stopping, 0 for no limit (default 1)"<<std::endl;
         std::cerr << "    [ --annotated-output <json|html|ast> ]generated annotated json or html output"<<std::endl;
+        std::cerr << "    [ --depfile <path> ]                  write a make dependency file listing all source files"<<std::endl;
+        std::cerr << "    [ --write-if-changed ]                keep output files untouched if their content did not change"<<std::endl;
+        std::cerr << "    [ --create-library-pack <path> ]      pack all files of a directory into the library pack given by -o"<<std::endl;
         std::cerr << "    <name.spin>                           spin file to compile"<<std::endl;
         std::cerr<<std::endl;
     }
@@ -64,9 +76,14 @@ struct CommandLineInterface {
 
     std::string m_inputFileName;
     std::string m_outputFileName;
-    std::vector<std::string> m_searchPath;
+    std::vector<std::string> m_searchPath; //directories and library packs in command line order
+    std::set<std::string> m_libraryPacks; //entries of m_searchPath which are library packs
+    std::string m_libraryPackDirectory;
+    std::string m_depFileName;
     CompilerSettings m_settings;
     bool m_quiet;
+    bool m_writeIfChanged;
+    bool m_stats;
 
     std::string parseArguments(const std::vector<std::string>& arguments) {
         m_settings.preDefinedMacros["__SPIN__"]="1";
@@ -91,7 +108,13 @@ struct CommandLineInterface {
             if (arg == "-L" || arg == "-I") {
                 if (!hasMoreArguments)
                     return "expected include path";
-                m_searchPath.push_back(arguments[++i]+"/");
+                const std::string& path = arguments[++i];
+                if (LibraryPack::isLibraryPack(path)) {
+                    m_libraryPacks.insert(path);
+                    m_searchPath.push_back(path);
+                }
+                else
+                    m_searchPath.push_back(path+"/");
             }
             else if (arg == "-o") {
                 if (!m_outputFileName.empty())
@@ -125,6 +148,18 @@ struct CommandLineInterface {
                 m_settings.compileDatOnly = true;
             else if (arg == "-u")
                 m_settings.unusedMethodOptimization = CompilerSettings::UnusedMethods::RemovePartial;
+            else if (arg == "-O0")
+                m_settings.optimization = CompilerSettings::Optimization::O0;
+            else if (arg == "-O1")
+                m_settings.optimization = CompilerSettings::Optimization::O1;
+            else if (arg == "-O2")
+                m_settings.optimization = CompilerSettings::Optimization::O2;
+            else if (arg == "-Os")
+                m_settings.optimization = CompilerSettings::Optimization::Os;
+            else if (arg == "--stats")
+                m_stats = true;
+            else if (arg == "--strict")
+                m_settings.strictMode = true;
             else if (arg == "-b")
                 m_settings.binaryMode = true;
             else if (arg == "-e")
@@ -133,6 +168,32 @@ struct CommandLineInterface {
                 m_settings.usePreProcessor = false;
             else if (arg == "-q")
                 m_quiet = true;
+            else if (arg == "--max-errors") {
+                if (!hasMoreArguments)
+                    return "error count expected";
+                auto numStr = arguments[++i];
+                size_t pos = 0;
+                try {
+                    m_settings.maxErrors = std::stoi(numStr,&pos);
+                }
+                catch(...) {
+                    return "invalid error count";
+                }
+                if (pos != numStr.size() || m_settings.maxErrors<0)
+                    return "invalid error count";
+            }
+            else if (arg == "--depfile") {
+                if (!hasMoreArguments)
+                    return "expected dependency filename";
+                m_depFileName = arguments[++i];
+            }
+            else if (arg == "--write-if-changed")
+                m_writeIfChanged = true;
+            else if (arg == "--create-library-pack") {
+                if (!hasMoreArguments)
+                    return "expected library directory";
+                m_libraryPackDirectory = arguments[++i];
+            }
             else if (arg == "--annotated-output") {
                 if (!hasMoreArguments)
                     return "annotated output type expected";
@@ -149,6 +210,13 @@ struct CommandLineInterface {
             else
                 return "unknown option '"+arg+"'";
         }
+        if (!m_libraryPackDirectory.empty()) {
+            if (!m_inputFileName.empty())
+                return "no input file expected when creating a library pack";
+            if (m_outputFileName.empty())
+                return "library pack requires an output filename";
+            return std::string();
+        }
         if (m_inputFileName.empty())
             return "no input file given";
         if (m_outputFileName.empty()) {
@@ -177,9 +245,26 @@ struct CommandLineInterface {
     bool run() {
         if (!m_quiet)
             banner();
-        DefaultFileHandler fileHandler(m_searchPath);
+        if (!m_libraryPackDirectory.empty())
+            return createLibraryPack();
+        std::vector<LibraryPackFileHandler::SearchEntry> searchList; //only used if there are library packs
+        for (const auto& path:m_libraryPacks.empty() ? std::vector<std::string>() : m_searchPath) {
+            if (m_libraryPacks.find(path) == m_libraryPacks.end()) {
+                searchList.push_back(LibraryPackFileHandler::SearchEntry(path));
+                continue;
+            }
+            auto pack = LibraryPack::open(path);
+            if (!pack) {
+                std::cerr<<"Invalid library pack '"<<path<<"'"<<std::endl;
+                return false;
+            }
+            searchList.push_back(LibraryPackFileHandler::SearchEntry(pack));
+        }
+        DefaultFileHandler defaultFileHandler(m_searchPath);
+        LibraryPackFileHandler packFileHandler(searchList);
+        AbstractFileHandler *fileHandler = m_libraryPacks.empty() ? static_cast<AbstractFileHandler*>(&defaultFileHandler) : &packFileHandler;
         CompilerResult result;
-        Compiler::runCompiler(result, &fileHandler, m_settings, m_inputFileName);
+        Compiler::runCompiler(result, fileHandler, m_settings, m_inputFileName);
         for (auto e:result.messages.errors) {
             auto m = result.messages.messageByType(e.errType);
             if (e.sourcePosition.file.file)
@@ -196,15 +281,82 @@ struct CommandLineInterface {
                 std::cerr<<"Aborted"<<std::endl;
             return false;
         }
+        if (m_stats)
+            printPassStatistics(result.passStatistics);
         if (m_settings.annotatedOutput == CompilerSettings::AnnotatedOutput::HTML) {
             if (!HtmlFiles::generate(result.binary)) {
                 std::cerr<<"Unable to generate HTML annotated output, HTML support might be disabled in this compiler"<<std::endl;
                 return false;
             }
         }
-        std::ofstream outFile(m_outputFileName, std::ios::out | std::ios::binary);
-        outFile.write(reinterpret_cast<const char*>(result.binary.data()), result.binary.size());
+        if (!writeFile(m_outputFileName, result.binary))
+            return false;
+        if (!m_depFileName.empty() && !writeFile(m_depFileName, dependencyFileContent(fileHandler->dependencies())))
+            return false;
+        if (!m_quiet)
+            std::cerr<<"Done"<<std::endl;
+        return true;
+    }
+
+    static void printPassStatistics(const std::vector<PassStatistics>& statistics) {
+        if (statistics.empty()) {
+            std::cerr<<"No optimization passes run"<<std::endl;
+            return;
+        }
+        std::cerr<<std::left<<std::setw(26)<<"Pass"<<std::right<<std::setw(8)<<"Runs"<<std::setw(10)<<"Changed"<<std::setw(12)<<"Time [ms]"<<"  Size delta"<<std::endl;
+        for (const auto& s:statistics) {
+            std::cerr<<std::left<<std::setw(26)<<s.name<<std::right<<std::setw(8)<<s.runs<<std::setw(10)<<s.changedMethods;
+            std::cerr<<std::setw(12)<<std::fixed<<std::setprecision(3)<<(s.microseconds/1000.0)<<"  "<<s.sizeDelta<<" "<<s.unit<<std::endl;
+        }
+    }
+
+    bool writeFile(const std::string& fileName, const std::vector<unsigned char>& content) const {
+        if (m_writeIfChanged) {
+            std::ifstream inFile(fileName, std::ios::in | std::ios::binary);
+            if (inFile && std::vector<unsigned char>((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>()) == content)
+                return true;
+        }
+        std::ofstream outFile(fileName, std::ios::out | std::ios::binary);
+        outFile.write(reinterpret_cast<const char*>(content.data()), content.size());
         outFile.close();
+        if (!outFile) {
+            std::cerr<<"Unable to write '"<<fileName<<"'"<<std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    //make syntax, one prerequisite per line
+    std::vector<unsigned char> dependencyFileContent(std::vector<std::string> dependencies) const {
+        //child objects are found in parallel, so only the root file has a fixed position
+        if (!dependencies.empty())
+            std::sort(dependencies.begin()+1, dependencies.end());
+        auto escape = [](const std::string& path) {
+            std::string result;
+            for (char c:path) {
+                if (c == ' ' || c == '#')
+                    result.push_back('\\');
+                else if (c == '$')
+                    result.push_back('$');
+                result.push_back(c);
+            }
+            return result;
+        };
+        std::string content = escape(m_outputFileName)+":";
+        for (const auto& dep:dependencies)
+            content += " \\\n  "+escape(dep);
+        content += "\n";
+        for (const auto& dep:dependencies) //phony targets, so deleted files do not break the build
+            content += "\n"+escape(dep)+":\n";
+        return std::vector<unsigned char>(content.begin(), content.end());
+    }
+
+    bool createLibraryPack() {
+        const std::string error = LibraryPack::create(m_libraryPackDirectory, m_outputFileName);
+        if (!error.empty()) {
+            std::cerr<<"Unable to create library pack: "<<error<<std::endl;
+            return false;
+        }
         if (!m_quiet)
             std::cerr<<"Done"<<std::endl;
         return true;
@@ -59,6 +59,18 @@ struct AnnotationWriter {
                 }
                 append("]");
             }
+            else if (auto map = std::dynamic_pointer_cast<BinaryAnnotation::MethodSourceMap>(annotation[i].extraInfo)) {
+                append(", [");
+                for (unsigned j=0; j<map->entries.size(); ++j) {
+                    appendComma(j,0xF,"            ");
+                    append("[");
+                    append(std::to_string(map->entries[j].offset));
+                    append(", ");
+                    append(std::to_string(map->entries[j].line));
+                    append("]");
+                }
+                append("]");
+            }
             append("]");
         }
         append("]");
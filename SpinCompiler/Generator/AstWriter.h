@@ -32,7 +32,7 @@ public:
         indent();
         for (auto c:m_rootObj->childObjects)
             if (c.isUsed)
-                addLine("childobj "+std::to_string(c.objectInstanceId.value())+" "+c.object->shortName+" "+c.numberOfInstances->toILangStr());
+                addLine("childobj "+std::to_string(c.objectInstanceId.value())+" "+c.shortName+" "+c.numberOfInstances->toILangStr());
         for (auto v:m_rootObj->globalVariables)
             addLine("var "+std::to_string(v->id.value())+" "+std::to_string(v->size)+" "+v->count->toILangStr());
         for (auto m:m_rootObj->methods) {
@@ -48,8 +48,8 @@ public:
 private:
     void generateInstructionNoExtraBlock(AbstractInstructionP instruction) {
         indent();
-        if (auto ei = std::dynamic_pointer_cast<BlockInstruction>(instruction)) {
-            for (auto i:ei->children)
+        if (instruction && instruction->kind == AbstractInstruction::BlockNode) {
+            for (auto i:static_cast<const BlockInstruction&>(*instruction).children)
                 generateInstruction(i);
         }
         else
@@ -57,79 +57,88 @@ private:
         undent();
     }
     void generateInstruction(AbstractInstructionP instruction) {
-        if (auto ei = std::dynamic_pointer_cast<ExpressionInstruction>(instruction)) {
-            addLine("expr "+ei->expression->toILangStr());
+        if (!instruction) {
+            addLine("illegal");
             return;
         }
-        if (auto ei = std::dynamic_pointer_cast<CogInitSpinInstruction>(instruction)) {
-            addLine("coginitspin");
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<CogInitAsmInstruction>(instruction)) {
-            addLine("coginitasm");
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<AbortOrReturnInstruction>(instruction)) {
-            addLine((ei->isAbort ? "abort " : "return ")+exprToStr(ei->returnValue));
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<NextOrQuitInstruction>(instruction)) {
-            addLine(ei->isNext ? "next" : "quit");
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<CallBuiltInInstruction>(instruction)) {
-            addLine("builtin");
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<BlockInstruction>(instruction)) {
-            addLine("block:");
-            indent();
-            for (auto i:ei->children)
-                generateInstruction(i);
-            undent();
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<IfInstruction>(instruction)) {
-            for (unsigned i=0; i<ei->branches.size(); ++i) {
-                auto b = ei->branches[i];
-                addLine(std::string(i>0 ? "else " : "")+(b.conditionInverted ? "ifn ": "if ")+exprToStr(b.condition)+":");
-                generateInstructionNoExtraBlock(b.instruction);
+        switch(instruction->kind) {
+            case AbstractInstruction::ExpressionNode: {
+                auto ei = static_cast<const ExpressionInstruction*>(instruction.get());
+                addLine("expr "+ei->expression->toILangStr());
+                return;
             }
-            if (ei->elseBranch) {
-                addLine("else:");
-                generateInstructionNoExtraBlock(ei->elseBranch);
+            case AbstractInstruction::CogInitSpinNode:
+                addLine("coginitspin");
+                return;
+            case AbstractInstruction::CogInitAsmNode:
+                addLine("coginitasm");
+                return;
+            case AbstractInstruction::AbortOrReturnNode: {
+                auto ei = static_cast<const AbortOrReturnInstruction*>(instruction.get());
+                addLine((ei->isAbort ? "abort " : "return ")+exprToStr(ei->returnValue));
+                return;
             }
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<CaseInstruction>(instruction)) {
-            addLine("case");
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<LoopConditionInstruction>(instruction)) {
-            switch(ei->type) {
-                case LoopConditionInstruction::RepeatCount:
-                    addLine("repeat count "+ei->condition->toILangStr()+":"); break;
-                case LoopConditionInstruction::PreWhile:
-                    addLine("repeat prewhile "+ei->condition->toILangStr()+":"); break;
-                case LoopConditionInstruction::PreUntil:
-                    addLine("repeat preuntil "+ei->condition->toILangStr()+":"); break;
-                case LoopConditionInstruction::PostWhile:
-                    addLine("repeat postwhile "+ei->condition->toILangStr()+":"); break;
-                case LoopConditionInstruction::PostUntil:
-                    addLine("repeat postuntil "+ei->condition->toILangStr()+":"); break;
-                case LoopConditionInstruction::RepeatEndless:
-                    addLine("repeat forever:"); break;
+            case AbstractInstruction::NextOrQuitNode: {
+                auto ei = static_cast<const NextOrQuitInstruction*>(instruction.get());
+                addLine(ei->isNext ? "next" : "quit");
+                return;
+            }
+            case AbstractInstruction::CallBuiltInNode:
+                addLine("builtin");
+                return;
+            case AbstractInstruction::BlockNode: {
+                auto ei = static_cast<const BlockInstruction*>(instruction.get());
+                addLine("block:");
+                indent();
+                for (auto i:ei->children)
+                    generateInstruction(i);
+                undent();
+                return;
+            }
+            case AbstractInstruction::IfNode: {
+                auto ei = static_cast<const IfInstruction*>(instruction.get());
+                for (unsigned i=0; i<ei->branches.size(); ++i) {
+                    auto b = ei->branches[i];
+                    addLine(std::string(i>0 ? "else " : "")+(b.conditionInverted ? "ifn ": "if ")+exprToStr(b.condition)+":");
+                    generateInstructionNoExtraBlock(b.instruction);
+                }
+                if (ei->elseBranch) {
+                    addLine("else:");
+                    generateInstructionNoExtraBlock(ei->elseBranch);
+                }
+                return;
+            }
+            case AbstractInstruction::CaseNode:
+                addLine("case");
+                return;
+            case AbstractInstruction::LoopConditionNode: {
+                auto ei = static_cast<const LoopConditionInstruction*>(instruction.get());
+                switch(ei->type) {
+                    case LoopConditionInstruction::RepeatCount:
+                        addLine("repeat count "+ei->condition->toILangStr()+":"); break;
+                    case LoopConditionInstruction::PreWhile:
+                        addLine("repeat prewhile "+ei->condition->toILangStr()+":"); break;
+                    case LoopConditionInstruction::PreUntil:
+                        addLine("repeat preuntil "+ei->condition->toILangStr()+":"); break;
+                    case LoopConditionInstruction::PostWhile:
+                        addLine("repeat postwhile "+ei->condition->toILangStr()+":"); break;
+                    case LoopConditionInstruction::PostUntil:
+                        addLine("repeat postuntil "+ei->condition->toILangStr()+":"); break;
+                    case LoopConditionInstruction::RepeatEndless:
+                        addLine("repeat forever:"); break;
+                }
+                generateInstructionNoExtraBlock(ei->instruction);
+                return;
+            }
+            case AbstractInstruction::LoopVarNode: {
+                auto ei = static_cast<const LoopVarInstruction*>(instruction.get());
+                std::string str = "repeat var "+ei->variable->toILangStr()+" "+ei->from->toILangStr()+" "+ei->to->toILangStr();
+                if (ei->step)
+                    str += " step "+ei->step->toILangStr();
+                addLine(str+":");
+                generateInstructionNoExtraBlock(ei->instruction);
+                return;
             }
-            generateInstructionNoExtraBlock(ei->instruction);
-            return;
-        }
-        if (auto ei = std::dynamic_pointer_cast<LoopVarInstruction>(instruction)) {
-            std::string str = "repeat var "+ei->variable->toILangStr()+" "+ei->from->toILangStr()+" "+ei->to->toILangStr();
-            if (ei->step)
-                str += " step "+ei->step->toILangStr();
-            addLine(str+":");
-            generateInstructionNoExtraBlock(ei->instruction);
-            return;
         }
         addLine("illegal");
     }
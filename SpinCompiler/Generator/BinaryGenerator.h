@@ -14,24 +14,28 @@
 #include "SpinCompiler/Generator/BinaryObject.h"
 #include "SpinCompiler/Generator/SpinByteCodeWriter.h"
 #include "SpinCompiler/Generator/Instruction.h"
+#include "SpinCompiler/Generator/PassManager.h"
 #include "SpinCompiler/Parser/ParsedObject.h"
 #include "SpinCompiler/Tokenizer/StringMap.h"
 #include "SpinCompiler/Generator/DatCodeGenerator.h"
 
 class BinaryGenerator {
 public:
-    static void generateBinaryForMethod(std::vector<unsigned char>& resultCode, std::vector<BinaryAnnotation>& resultAnnotation, AbstractBinaryGenerator *generator, ParsedObjectP currentObject, ParsedObject::MethodP method, int globalAddressStartCode) {
+    static void generateBinaryForMethod(std::vector<unsigned char>& resultCode, std::vector<BinaryAnnotation>* resultAnnotation, AbstractBinaryGenerator *generator, PassManager& passManager, ParsedObjectP currentObject, ParsedObject::MethodP method, int globalAddressStartCode) {
 
-        std::vector<SpinFunctionByteCodeEntry> intermediateCode;
+        AstArena::Scope astScope(method->bodyArena); //nodes created by the passes go away with the body
+        SpinFunctionByteCode intermediateCode(resultAnnotation != nullptr);
         SpinByteCodeWriter byteCodeWriter(intermediateCode);
         InstructionLoopContext rootLoopContext; //no loop block
-        method->functionBody->generate(byteCodeWriter, rootLoopContext);
+        passManager.runAstPasses(method->functionBody)->generate(byteCodeWriter, rootLoopContext);
+        passManager.runByteCodePasses(intermediateCode, byteCodeWriter);
         auto strings = byteCodeWriter.retrieveAllStrings();
 
         BinaryGenerator spinBinGen(generator, currentObject, intermediateCode);
         spinBinGen.generateByteCode(globalAddressStartCode);
         spinBinGen.replaceStringPatches(stringConstantsGetOffsets(strings, globalAddressStartCode+spinBinGen.m_resultByteCode.size()));
-        resultAnnotation.push_back(BinaryAnnotation(BinaryAnnotation::Method, spinBinGen.m_resultByteCode.size()));
+        if (resultAnnotation)
+            resultAnnotation->push_back(BinaryAnnotation(BinaryAnnotation::Method, spinBinGen.m_resultByteCode.size(), spinBinGen.sourceMapAnnotation(globalAddressStartCode)));
         //std::cout<<generator->getNameBySymbolId(method->symbolId)<<std::endl;
         resultCode.insert(resultCode.end(), spinBinGen.m_resultByteCode.begin(), spinBinGen.m_resultByteCode.end());
         //append strings
@@ -46,7 +50,8 @@ public:
             resultCode.push_back(char(0));
             stringTotalSize += s.characters.size()+1; //including null character
         }
-        resultAnnotation.push_back(BinaryAnnotation(BinaryAnnotation::StringPool, stringTotalSize));
+        if (resultAnnotation)
+            resultAnnotation->push_back(BinaryAnnotation(BinaryAnnotation::StringPool, stringTotalSize));
     }
 private:
     struct StringPatch {
@@ -60,24 +65,31 @@ private:
     std::map<SpinByteCodeLabel,int> m_addressOfLabel;
     AbstractBinaryGenerator *m_generator;
     ParsedObjectP m_currentObject;
-    const std::vector<SpinFunctionByteCodeEntry>& m_methodCode;
+    const SpinFunctionByteCode& m_methodCode;
 
-    BinaryGenerator(AbstractBinaryGenerator *generator, ParsedObjectP currentObject, const std::vector<SpinFunctionByteCodeEntry>& methodCode):m_generator(generator),m_currentObject(currentObject),m_methodCode(methodCode) {}
+    BinaryGenerator(AbstractBinaryGenerator *generator, ParsedObjectP currentObject, const SpinFunctionByteCode& methodCode):m_generator(generator),m_currentObject(currentObject),m_methodCode(methodCode) {}
 
-    void replaceStringPatches(const std::vector<int>& stringOffsets) {
+    BinaryAnnotation::AbstractExtraInfoP sourceMapAnnotation(const int globalStartAddress) const {
+        auto result = new BinaryAnnotation::MethodSourceMap();
+        for (const auto& e:m_methodCode.sourceMap)
+            result->entries.push_back(BinaryAnnotation::MethodSourceMap::Entry(m_absoluteAddresses[e.entry]-globalStartAddress, e.line));
+        return BinaryAnnotation::AbstractExtraInfoP(result);
+    }
+
+    void replaceStringPatches(const std::map<int,int>& stringOffsets) {
         for (auto patch:m_stringPatches) {
-            const int stringPtr = (patch.stringNumber>=0 && size_t(patch.stringNumber)<stringOffsets.size()) ? stringOffsets[patch.stringNumber] : 0;
+            auto it = stringOffsets.find(patch.stringNumber);
+            const int stringPtr = it != stringOffsets.end() ? it->second : 0;
             m_resultByteCode[patch.byteCodeOffset] = (((stringPtr >> 8) & 0xFF) | 0x80);
             m_resultByteCode[patch.byteCodeOffset+1] = stringPtr & 0xFF;
         }
     }
 
-    static std::vector<int> stringConstantsGetOffsets(const std::vector<SpinStringInfo>& strings, const int baseOffset) {
-        std::vector<int> result;
-        result.reserve(strings.size());
+    static std::map<int,int> stringConstantsGetOffsets(const std::vector<SpinStringInfo>& strings, const int baseOffset) {
+        std::map<int,int> result; //by string number
         int strOffset = baseOffset;
         for (const auto& s: strings) {
-            result.push_back(strOffset);
+            result[s.stringNumber] = strOffset;
             strOffset += s.characters.size()+1; //including null character
         }
         return result;
@@ -91,13 +103,20 @@ private:
         while (true) {
             m_resultByteCode.clear();
             m_stringPatches.clear();
+            const unsigned char *staticByte = m_methodCode.staticBytes.data();
+            const SpinFunctionByteCode::Operand *operand = m_methodCode.operands.data();
+            const AbstractConstantExpressionP *expression = m_methodCode.expressions.data();
             for (unsigned int i=0; i<m_methodCode.size(); ++i) {
                 const int thisAddr = globalStartAddress+m_resultByteCode.size();
                 if (m_absoluteAddresses[i] != thisAddr) {
                     m_absoluteAddresses[i] = thisAddr;
                     absAddrModified = true;
                 }
-                generateByteCodeForElement(m_methodCode[i], thisAddr, absAddrModified);
+                const auto type = SpinFunctionByteCodeEntry::Type(m_methodCode.types[i]);
+                if (type == SpinFunctionByteCodeEntry::StaticByte)
+                    m_resultByteCode.push_back(*staticByte++);
+                else
+                    generateByteCodeForElement(type, *operand++, type == SpinFunctionByteCodeEntry::PushExprConstant ? (expression++)->get() : nullptr, thisAddr, absAddrModified);
             }
             if (m_resultByteCode.size() == lastSize && !absAddrModified)
                 return;
@@ -113,13 +132,12 @@ private:
         return it->second;
     }
 
-    void generateByteCodeForElement(SpinFunctionByteCodeEntry e, int currentAbsoluteAddress, bool &labelAddressModified) {
-        switch(e.type) {
+    void generateByteCodeForElement(SpinFunctionByteCodeEntry::Type type, const SpinFunctionByteCode::Operand& e, const AbstractConstantExpression* expression, int currentAbsoluteAddress, bool &labelAddressModified) {
+        switch(type) {
             case SpinFunctionByteCodeEntry::StaticByte:
-                m_resultByteCode.push_back(e.value);
-                break;
+                break; //emitted by generateByteCode
             case SpinFunctionByteCodeEntry::PushExprConstant:
-                generateByteCodeForPushConstant(e.expression->evaluate(m_generator),ConstantEncoding(e.id));
+                generateByteCodeForPushConstant(expression->evaluate(m_generator),ConstantEncoding(e.id));
                 break;
             case SpinFunctionByteCodeEntry::PushIntConstant:
                 generateByteCodeForPushConstant(e.value,ConstantEncoding(e.id));
@@ -144,13 +162,13 @@ private:
                 break;
             }
             case SpinFunctionByteCodeEntry::VariableVar:
-                generateVariableReferenceByteCode(e.type, e.value, m_generator->addressOfVarSymbol(VarSymbolId(e.id)));
+                generateVariableReferenceByteCode(type, e.value, m_generator->addressOfVarSymbol(VarSymbolId(e.id)));
                 break;
             case SpinFunctionByteCodeEntry::VariableDat:
-                generateVariableReferenceByteCode(e.type, e.value, m_generator->valueOfDatSymbol(DatSymbolId(e.id), false));
+                generateVariableReferenceByteCode(type, e.value, m_generator->valueOfDatSymbol(DatSymbolId(e.id), false));
                 break;
             case SpinFunctionByteCodeEntry::VariableLoc:
-                generateVariableReferenceByteCode(e.type, e.value, e.id<0 ? 0 : m_generator->addressOfLocSymbol(LocSymbolId(e.id)));
+                generateVariableReferenceByteCode(type, e.value, e.id<0 ? 0 : m_generator->addressOfLocSymbol(LocSymbolId(e.id)));
                 break;
             case SpinFunctionByteCodeEntry::PlaceLabel: {
                 SpinByteCodeLabel lbl(e.value);
@@ -282,19 +300,24 @@ private:
 };
 
 struct GeneratorGlobalState {
-    GeneratorGlobalState(const CompilerSettings &settings):settings(settings) {}
+    GeneratorGlobalState(const CompilerSettings &settings):settings(settings),passManager(settings.optimization),evaluationThread(std::this_thread::get_id()) {}
     std::map<ParsedObject*,BinaryObjectP> generatedObjects;
     std::map<ParsedObject*,BinaryObjectP> generatedConstantOnlyObjects;
     const CompilerSettings &settings;
+    PassManager passManager;
+    const std::thread::id evaluationThread; //objects are generated one after another on the thread creating this state
 };
 
 class BinaryObjectGenerator : public AbstractBinaryGenerator {
 public:
     struct DatSymbolOffset {
-        DatSymbolOffset():objPtr(0),cogOrg(0) {}
+        DatSymbolOffset():objPtr(-1),cogOrg(0) {}
         DatSymbolOffset(int objPtr, int cogOrg):objPtr(objPtr),cogOrg(cogOrg) {}
         int objPtr;
         int cogOrg;
+        bool valid() const {
+            return objPtr>=0;
+        }
     };
 
 private:
@@ -302,18 +325,19 @@ private:
     GeneratorGlobalState& m_globalState;
     const StringMap& m_stringMap;
     ParsedObjectP m_parsedObject;
-    std::map<ObjectInstanceId, int> m_objectInstanceIdToObjectOffset;
-    std::map<ObjectClassId,std::vector<int>> m_objectConstantsByObjectClass;
-    std::map<DatSymbolId,DatSymbolOffset> m_datSymbols;
-    std::map<VarSymbolId,int> m_varSymbols;
-    std::map<LocSymbolId,int> m_locSymbols;
+    //ids are small and reserved one by one per object, so they index these tables, -1 for unset entries
+    std::vector<int> m_objectInstanceIdToObjectOffset;
+    std::vector<std::vector<int>> m_objectConstantsByObjectClass;
+    std::vector<DatSymbolOffset> m_datSymbols;
+    std::vector<int> m_varSymbols;
+    std::vector<int> m_locSymbols;
     BuildState m_state;
     BinaryObjectP m_result;
     int m_virtualAdditionalBinarySize;
     int m_cogOrg;
 public:
     virtual ~BinaryObjectGenerator() {}
-    explicit BinaryObjectGenerator(GeneratorGlobalState& globalState, const StringMap& nameMap,  ParsedObjectP& parsedObject):m_globalState(globalState),m_stringMap(nameMap),m_parsedObject(parsedObject),m_state(Init),m_result(BinaryObjectP(new BinaryObject())),m_virtualAdditionalBinarySize(0),m_cogOrg(0) {}
+    explicit BinaryObjectGenerator(GeneratorGlobalState& globalState, const StringMap& nameMap,  ParsedObjectP& parsedObject):AbstractBinaryGenerator(globalState.evaluationThread),m_globalState(globalState),m_stringMap(nameMap),m_parsedObject(parsedObject),m_state(Init),m_result(BinaryObjectP(new BinaryObject())),m_virtualAdditionalBinarySize(0),m_cogOrg(0) {}
     static BinaryObjectP generateBinary(GeneratorGlobalState& globalState, const StringMap& nameMap, ParsedObjectP& parsedObject, const bool onlyConstants) {
         auto previousBuilt = globalState.generatedObjects.find(parsedObject.get());
         if (previousBuilt != globalState.generatedObjects.end())
@@ -335,27 +359,30 @@ public:
     virtual int mapObjectInstanceIdToOffset(ObjectInstanceId objectIndexId) const {
         if (m_state<ObjectTable)
             throw CompilerError(ErrorType::internal);
-        auto res = m_objectInstanceIdToObjectOffset.find(objectIndexId);
-        if (res == m_objectInstanceIdToObjectOffset.end())
-            throw CompilerError(ErrorType::internal);
-        return res->second;
+        return denseValue(m_objectInstanceIdToObjectOffset, objectIndexId.value());
     }
 
     virtual int valueOfConstantOfObjectClass(ObjectClassId objectClass, int constantIndex) const {
         if (m_state<MethodTable)
             throw CompilerError(ErrorType::internal);
-        auto res = m_objectConstantsByObjectClass.find(objectClass);
-        if (res == m_objectConstantsByObjectClass.end())
+        if (!objectClass.valid() || objectClass.value()>=int(m_objectConstantsByObjectClass.size()))
             throw CompilerError(ErrorType::internal);
-        if (constantIndex<0 || constantIndex>=int(res->second.size()))
+        const auto& constants = m_objectConstantsByObjectClass[objectClass.value()];
+        if (constantIndex<0 || constantIndex>=int(constants.size()))
             throw CompilerError(ErrorType::internal);
-        return res->second[constantIndex];
+        return constants[constantIndex];
     }
 
     virtual void setDatSymbol(DatSymbolId datSymbolId, int objPtr, int cogOrg) {
         if (m_state != ObjectTable)
             throw CompilerError(ErrorType::internal);
-        m_datSymbols[datSymbolId] = DatSymbolOffset(objPtr, cogOrg);
+        if (!datSymbolId.valid() || datSymbolId.value()>=int(m_datSymbols.size()))
+            throw CompilerError(ErrorType::internal);
+        auto& sym = m_datSymbols[datSymbolId.value()];
+        if (sym.objPtr == objPtr && sym.cogOrg == cogOrg)
+            return;
+        sym = DatSymbolOffset(objPtr, cogOrg);
+        invalidateEvaluations();
     }
 
     virtual int& currentDatCogOrg() {
@@ -366,13 +393,13 @@ public:
     virtual int valueOfDatSymbol(DatSymbolId datSymbolId, bool cogPosition) const {
         if (m_state<ObjectTable)
             throw CompilerError(ErrorType::internal);
-        auto res = m_datSymbols.find(datSymbolId);
-        if (res == m_datSymbols.end())
+        if (!datSymbolId.valid() || datSymbolId.value()>=int(m_datSymbols.size()) || !m_datSymbols[datSymbolId.value()].valid())
             throw CompilerError(ErrorType::internal);
+        const auto& sym = m_datSymbols[datSymbolId.value()];
         if (!cogPosition)
-            return res->second.objPtr;
+            return sym.objPtr;
         // the offset to the label symbol is in second symbol value
-        int cogOrg = res->second.cogOrg;
+        int cogOrg = sym.cogOrg;
         // make sure it's long aligned
         if (cogOrg & 0x03)
             throw CompilerError(ErrorType::ainl);
@@ -386,19 +413,13 @@ public:
     virtual int addressOfVarSymbol(VarSymbolId varSymbolId) const {
         if (m_state<ObjectTable)
             throw CompilerError(ErrorType::internal);
-        auto res = m_varSymbols.find(varSymbolId);
-        if (res == m_varSymbols.end())
-            throw CompilerError(ErrorType::internal);
-        return res->second;
+        return denseValue(m_varSymbols, varSymbolId.value());
     }
 
     virtual int addressOfLocSymbol(LocSymbolId locSymbolId) const {
         if (m_state<ObjectTable)
             throw CompilerError(ErrorType::internal);
-        auto res = m_locSymbols.find(locSymbolId);
-        if (res == m_locSymbols.end())
-            throw CompilerError(ErrorType::internal);
-        return res->second;
+        return denseValue(m_locSymbols, locSymbolId.value());
     }
 
     virtual std::string getNameBySymbolId(SpinSymbolId symbol) const {
@@ -407,6 +428,10 @@ public:
     BinaryObjectP run(const bool onlyConstants) {
         if (m_state != Init)
             throw CompilerError(ErrorType::internal);
+        m_objectInstanceIdToObjectOffset.assign(m_parsedObject->objectInstanceIdLimit(), -1);
+        m_objectConstantsByObjectClass.assign(m_parsedObject->objectClassIdLimit(), std::vector<int>());
+        m_datSymbols.assign(m_parsedObject->datSymbolIdLimit(), DatSymbolOffset());
+        m_varSymbols.assign(m_parsedObject->varSymbolIdLimit(), -1);
         //retrieve all child objects
         auto objectClassToChildObjectIndex = generateChildObjects(onlyConstants);
         //size of following tables
@@ -423,8 +448,9 @@ public:
         m_state = ObjectTable;
 
         if (!onlyConstants) {
-            DatCodeGenerator(m_result->ownData, m_result->ownDataAnnotation, this, m_parsedObject->datCode, objectBinarySize(), false).generate();
-            DatCodeGenerator(m_result->ownData, m_result->ownDataAnnotation, this, m_parsedObject->datCode, objectBinarySize(), true).generate();
+            DatCodeGenerator(m_result->ownData, ownDataAnnotation(), this, m_parsedObject->datCode, objectBinarySize(), false).generate();
+            DatCodeGenerator(m_result->ownData, ownDataAnnotation(), this, m_parsedObject->datCode, objectBinarySize(), true).generate();
+            std::vector<DatCodeEntry>().swap(m_parsedObject->datCode); //an object is generated only once, the expression nodes stay in the parser's arena
         }
         m_state = DatSectionDone;
 
@@ -445,7 +471,7 @@ public:
                 m_result->ownData.push_back(0);
                 ++padSize;
             }
-            if (padSize>0)
+            if (padSize>0 && ownDataAnnotation())
                 m_result->ownDataAnnotation.push_back(BinaryAnnotation(BinaryAnnotation::Padding,padSize));
         }
         m_result->objectSize = objectBinarySize();
@@ -472,15 +498,24 @@ private:
             //search normal object
             auto objIt = objectClassToChildObjectIndex.find(ch.objectClass);
             if (objIt != objectClassToChildObjectIndex.end()) { //found obj
-                m_objectConstantsByObjectClass[ch.objectClass] = m_result->childObjects[objIt->second]->constants;
+                m_objectConstantsByObjectClass[ch.objectClass.value()] = m_result->childObjects[objIt->second]->constants;
                 continue;
             }
             //object was unused, built only for constants
             auto unusedObjConstants = BinaryObjectGenerator::generateBinary(m_globalState,m_stringMap,ch.object, true)->constants;
-            m_objectConstantsByObjectClass[ch.objectClass] = unusedObjConstants;
+            m_objectConstantsByObjectClass[ch.objectClass.value()] = unusedObjConstants;
         }
         return objectClassToChildObjectIndex;
     }
+    //annotations are only collected for annotated output, plain builds skip all names and section sizes
+    std::vector<BinaryAnnotation>* ownDataAnnotation() const {
+        return m_globalState.settings.annotatedOutput != CompilerSettings::AnnotatedOutput::None ? &m_result->ownDataAnnotation : nullptr;
+    }
+    static int denseValue(const std::vector<int>& table, int id) {
+        if (id<0 || id>=int(table.size()) || table[id]<0)
+            throw CompilerError(ErrorType::internal);
+        return table[id];
+    }
     int objectBinarySize() const {
         return m_virtualAdditionalBinarySize + int(m_result->ownData.size());
     }
@@ -489,10 +524,10 @@ private:
         //returns the size of the stack excluding parameters and result
         int localByteOffset = 0;
         int parameterAndResultSize = 0;
-        m_locSymbols.clear();
+        m_locSymbols.assign(method->allLocals.size(), -1);
         for (int j=0; j<int(method->allLocals.size()); ++j) {
             const auto& loc = method->allLocals[j];
-            m_locSymbols[loc.localVarId] = localByteOffset;
+            m_locSymbols[loc.localVarId.value()] = localByteOffset;
             localByteOffset += 4*loc.count->evaluate(this);
             if (localByteOffset > SpinLimits::LocLimit)
                 throw CompilerError(ErrorType::loxlve, loc.sourcePosition);
@@ -502,18 +537,23 @@ private:
         return localByteOffset-parameterAndResultSize;
     }
     void generateMethods() {
-        m_result->annotatedMethodNames = BinaryAnnotation::TableEntryNamesP(new BinaryAnnotation::TableEntryNames());
+        if (ownDataAnnotation())
+            m_result->annotatedMethodNames = BinaryAnnotation::TableEntryNamesP(new BinaryAnnotation::TableEntryNames());
         for (auto method:m_parsedObject->methods) {
             //calculate stack size for locals (exluding result value and parameters)
             const int sumLocalVarStackSize = generateLocalsForMethod(method);
             m_result->methodTable.push_back((objectBinarySize()&0xFFFF) | (sumLocalVarStackSize << 16));
-            m_result->annotatedMethodNames->names.push_back(getNameBySymbolId(method->symbolId));
-            BinaryGenerator::generateBinaryForMethod(m_result->ownData, m_result->ownDataAnnotation, this, m_parsedObject, method, objectBinarySize());
+            if (m_result->annotatedMethodNames)
+                m_result->annotatedMethodNames->names.push_back(getNameBySymbolId(method->symbolId));
+            BinaryGenerator::generateBinaryForMethod(m_result->ownData, ownDataAnnotation(), this, m_globalState.passManager, m_parsedObject, method, objectBinarySize());
+            method->functionBody.reset(); //byte code is final
+            method->bodyArena.reset();
             m_locSymbols.clear();
         }
     }
     int generateChildInstanceTable(std::map<ObjectClassId,int> &objectClassToChildObjectIndex) {
-        m_result->annotatedInstanceNames = BinaryAnnotation::TableEntryNamesP(new BinaryAnnotation::TableEntryNames());
+        if (ownDataAnnotation())
+            m_result->annotatedInstanceNames = BinaryAnnotation::TableEntryNamesP(new BinaryAnnotation::TableEntryNames());
         m_result->objectStart = objectBinarySize();
         m_result->objectCount = 0;
         int objectOffset = m_parsedObject->methods.size()+1;
@@ -521,17 +561,18 @@ private:
         for (auto childObj:m_parsedObject->childObjects) {
             if (!childObj.isUsed)
                 continue;
-            m_objectInstanceIdToObjectOffset[childObj.objectInstanceId] = objectOffset;
+            m_objectInstanceIdToObjectOffset[childObj.objectInstanceId.value()] = objectOffset;
             const int instanceCount = childObj.numberOfInstances->evaluate(this);
             if (instanceCount < 1 || instanceCount > 255)
                 throw CompilerError(ErrorType::ocmbf1tx);
-            auto instanceName = getNameBySymbolId(childObj.symbolId);
+            const auto instanceName = m_result->annotatedInstanceNames ? getNameBySymbolId(childObj.symbolId) : std::string();
             for (int i=0; i < instanceCount; i++) {
                 if (objectBinarySize() >= 256*4) //TODO konstante nicht hardcoden
                     throw CompilerError(ErrorType::loxspoe);
                 const int childObjectIndex = objectClassToChildObjectIndex[childObj.objectClass];
                 m_result->objectInstanceIndices.push_back(childObjectIndex);
-                m_result->annotatedInstanceNames->names.push_back(instanceCount>1 ? instanceName+"["+std::to_string(i)+"]" : instanceName);
+                if (m_result->annotatedInstanceNames)
+                    m_result->annotatedInstanceNames->names.push_back(instanceCount>1 ? instanceName+"["+std::to_string(i)+"]" : instanceName);
                 m_virtualAdditionalBinarySize += 4;
                 m_result->objectCount++;
                 childVarSize += m_result->childObjects[childObjectIndex]->totalVarSize();
@@ -563,11 +604,11 @@ private:
                     varLongBytes += nCount<<2;
                     break;
             }
-            m_varSymbols[v->id] = varAddr;
+            m_varSymbols[v->id.value()] = varAddr;
         }
         //vars are ordered by size (longs, words, bytes), so address of words and vars must be adjusted
         for (auto v:m_parsedObject->globalVariables) {
-            int varAddr = m_varSymbols[v->id];
+            int varAddr = m_varSymbols[v->id.value()];
             switch(v->size) {
                 case 0: //bytes follow words
                     varAddr += varLongBytes+varWordBytes;
@@ -580,7 +621,7 @@ private:
             }
             if (varAddr > SpinLimits::VarLimit || varAddr<0)
                 throw CompilerError(ErrorType::tmvsid, v->sourcePosition);
-            m_varSymbols[v->id] = varAddr;
+            m_varSymbols[v->id.value()] = varAddr;
         }
 
         // calculate var_ptr and align to long
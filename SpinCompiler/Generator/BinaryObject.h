@@ -63,7 +63,7 @@ struct BinaryObject {
         return ((settings.defaultCompileMode) ? 4 : 0)+methodTable.size()*4+objectInstanceIndices.size()*4+ownData.size();
     }
 
-    void distilledToBinary(std::vector<unsigned char> &result, std::vector<BinaryAnnotation>& resultAnnotation, const CompilerSettings &settings) {
+    void distilledToBinary(std::vector<unsigned char> &result, std::vector<BinaryAnnotation>* resultAnnotation, const CompilerSettings &settings) {
         std::vector<SameObjectPair> sameObjects;
         auto distilled = distill(sameObjects);
         std::map<const BinaryObject*,int> objectOffsets;
@@ -140,10 +140,11 @@ private:
         return result;
     }
 
-    void singleObjectToBinary(std::vector<unsigned char> &result, std::vector<BinaryAnnotation>& resultAnnotation, const CompilerSettings &settings, const std::map<const BinaryObject*,int> &objectOffsets) const {
+    void singleObjectToBinary(std::vector<unsigned char> &result, std::vector<BinaryAnnotation>* resultAnnotation, const CompilerSettings &settings, const std::map<const BinaryObject*,int> &objectOffsets) const {
         const int startOffsetOfThisObject=result.size();
         if (settings.defaultCompileMode) {
-            resultAnnotation.push_back(BinaryAnnotation(BinaryAnnotation::ObjectHeader, 4));
+            if (resultAnnotation)
+                resultAnnotation->push_back(BinaryAnnotation(BinaryAnnotation::ObjectHeader, 4));
             result.push_back(objectSize & 0xFF);
             result.push_back((objectSize>>8) & 0xFF);
             result.push_back((objectStart>>2) & 0xFF);
@@ -151,10 +152,12 @@ private:
         }
         int varOffset=ownVarSize;
         //add method table
-        resultAnnotation.push_back(BinaryAnnotation(BinaryAnnotation::MethodTable, 4*methodTable.size(), annotatedMethodNames));
+        if (resultAnnotation)
+            resultAnnotation->push_back(BinaryAnnotation(BinaryAnnotation::MethodTable, 4*methodTable.size(), annotatedMethodNames));
         for (int m:methodTable)
             addLong(result, m);
-        resultAnnotation.push_back(BinaryAnnotation(BinaryAnnotation::ObjectTable, 4*objectInstanceIndices.size(), annotatedInstanceNames));
+        if (resultAnnotation)
+            resultAnnotation->push_back(BinaryAnnotation(BinaryAnnotation::ObjectTable, 4*objectInstanceIndices.size(), annotatedInstanceNames));
         //add obj table
         for (unsigned int i=0; i<objectInstanceIndices.size(); ++i) {
             const auto obj = childObjects[objectInstanceIndices[i]];
@@ -167,7 +170,8 @@ private:
                 throw CompilerError(ErrorType::tmvsid);
         }
         result.insert(result.end(),ownData.begin(),ownData.end());
-        resultAnnotation.insert(resultAnnotation.end(),ownDataAnnotation.begin(),ownDataAnnotation.end());
+        if (resultAnnotation)
+            resultAnnotation->insert(resultAnnotation->end(),ownDataAnnotation.begin(),ownDataAnnotation.end());
 
     }
     static void addLong(std::vector<unsigned char>& result, int value) {
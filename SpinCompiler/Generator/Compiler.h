@@ -23,15 +23,18 @@ struct CompilerResult {
     std::vector<unsigned char> binary;
     CompilerMessages messages;
     std::vector<BinaryAnnotation> annotation;
+    std::vector<PassStatistics> passStatistics;
 };
 
 struct Compiler {
     static void runCompiler(CompilerResult &result, AbstractFileHandler *fileHandler, const CompilerSettings& settings, const std::string& rootFileName) noexcept {
         try {
-            auto parser = new Parser(fileHandler, settings);
+            std::unique_ptr<Parser> parser(new Parser(fileHandler, settings)); //joins the parser threads before the caller may delete fileHandler
+            AstArena::Scope astScope(parser->astArena); //the generator creates nodes too
             auto rootObj = parser->compileObject(fileHandler->findFile(rootFileName,AbstractFileHandler::RootSpinFile,FileDescriptorP(),SourcePosition()), nullptr, SourcePosition());
             if (settings.unusedMethodOptimization != CompilerSettings::UnusedMethods::Keep)
-                UnusedMethodElimination::eliminateUnused(rootObj, settings.unusedMethodOptimization == CompilerSettings::UnusedMethods::RemovePartial);
+                UnusedMethodElimination::eliminateUnused(rootObj, settings.unusedMethodOptimization == CompilerSettings::UnusedMethods::RemovePartial, parser.get());
+            parser->releaseObjectSources(); //all method bodies are parsed now
 
             if (settings.annotatedOutput == CompilerSettings::AnnotatedOutput::AST) {
                 for (auto o:parser->listAllObjects(rootObj)) {
@@ -42,13 +45,13 @@ struct Compiler {
             }
 
             GeneratorGlobalState globalGeneratorState(settings);
-            BinaryObjectGenerator binGen(globalGeneratorState, parser->stringMap, rootObj);
-            auto bin = binGen.run(false);
+            auto bin = BinaryObjectGenerator(globalGeneratorState, parser->stringMap, rootObj).run(false); //symbol tables of the generator are released right after
+            result.passStatistics = globalGeneratorState.passManager.statistics();
             globalGeneratorState.generatedObjects[rootObj.get()] = bin;
             std::vector<unsigned char> tmpRes;
             std::map<BinaryObject*,int> alreadyGenerated;
 
-            bin->distilledToBinary(tmpRes,result.annotation,globalGeneratorState.settings);
+            bin->distilledToBinary(tmpRes,settings.annotatedOutput != CompilerSettings::AnnotatedOutput::None ? &result.annotation : nullptr,globalGeneratorState.settings);
 
             if (settings.annotatedOutput != CompilerSettings::AnnotatedOutput::None) {
                 AnnotationWriter awr(tmpRes,result.annotation);
@@ -72,6 +75,10 @@ struct Compiler {
         catch(CompilerError& e) {
             result.messages.addError(e);
         }
+        catch(CompilerErrorList& list) {
+            for (const auto& e:list.errors)
+                result.messages.addError(e);
+        }
     }
 };
 
@@ -17,13 +17,13 @@
 
 class DatCodeGenerator {
 public:
-    DatCodeGenerator(std::vector<unsigned char>& resultCode, std::vector<BinaryAnnotation>& resultAnnotation, AbstractBinaryGenerator* generator, const std::vector<DatCodeEntry>& code, const int objOffsetPtr, const bool finalRun):
+    DatCodeGenerator(std::vector<unsigned char>& resultCode, std::vector<BinaryAnnotation>* resultAnnotation, AbstractBinaryGenerator* generator, const std::vector<DatCodeEntry>& code, const int objOffsetPtr, const bool finalRun):
         resultCode(resultCode),resultAnnotation(resultAnnotation),generator(generator),code(code),objOffsetPtr(objOffsetPtr),cogOrg(generator->currentDatCogOrg()),resultSize(0),finalRun(finalRun),orgXMode(false) {
         cogOrg=0;
     }
 private:
     std::vector<unsigned char>& resultCode;
-    std::vector<BinaryAnnotation>& resultAnnotation;
+    std::vector<BinaryAnnotation>* resultAnnotation; //nullptr if no annotations are collected
     std::vector<BinaryAnnotation::DatAnnotation::Entry> annotations; //even entries are raw bytes, odd entries are asm bytes
     AbstractBinaryGenerator* generator;
     const std::vector<DatCodeEntry>& code;
@@ -43,18 +43,20 @@ private:
                 resultCode.push_back((value >> 16) & 0x000000FF);
                 resultCode.push_back((value >> 24) & 0x000000FF);
             }
-            auto tpe = isDataEntry ? BinaryAnnotation::DatAnnotation::Entry::Data : BinaryAnnotation::DatAnnotation::Entry::Instruction;
-            if (annotations.empty() || annotations.back().type != tpe)
-                annotations.push_back(BinaryAnnotation::DatAnnotation::Entry(tpe, byteCount));
-            else
-                annotations.back().value += byteCount;
+            if (resultAnnotation) {
+                auto tpe = isDataEntry ? BinaryAnnotation::DatAnnotation::Entry::Data : BinaryAnnotation::DatAnnotation::Entry::Instruction;
+                if (annotations.empty() || annotations.back().type != tpe)
+                    annotations.push_back(BinaryAnnotation::DatAnnotation::Entry(tpe, byteCount));
+                else
+                    annotations.back().value += byteCount;
+            }
         }
         resultSize += byteCount;
         if (!orgXMode)
             cogOrg += byteCount;
     }
     void appendAnnotation(BinaryAnnotation::DatAnnotation::Entry::Type type, int value) {
-        if (finalRun)
+        if (finalRun && resultAnnotation)
             annotations.push_back(BinaryAnnotation::DatAnnotation::Entry(type, value));
     }
 public:
@@ -128,8 +130,8 @@ public:
                 }
             }
         }
-        if (finalRun)
-            resultAnnotation.push_back(BinaryAnnotation(BinaryAnnotation::DatSection,resultSize,BinaryAnnotation::AbstractExtraInfoP(new BinaryAnnotation::DatAnnotation(annotations))));
+        if (finalRun && resultAnnotation)
+            resultAnnotation->push_back(BinaryAnnotation(BinaryAnnotation::DatSection,resultSize,BinaryAnnotation::AbstractExtraInfoP(new BinaryAnnotation::DatAnnotation(annotations))));
     }
 };
 
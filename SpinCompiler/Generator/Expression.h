@@ -13,44 +13,47 @@
 
 #include "SpinCompiler/Generator/SpinByteCodeWriter.h"
 #include "SpinCompiler/Types/ConstantExpression.h"
-#include <functional>
 
 class AbstractExpression {
 public:
+    //node type tag, traversals switch on it instead of virtual calls or casts
+    enum Kind {
+        VariableNode,
+        UnaryAssignNode,
+        AssignNode,
+        CogNewSpinNode,
+        CogNewAsmNode,
+        MethodCallNode,
+        LookNode,
+        PushConstantNode,
+        PushStringNode,
+        CallBuiltInNode,
+        UnaryNode,
+        BinaryNode,
+        AtAtNode
+    };
+    const Kind kind;
     const SourcePosition sourcePosition;
 
-    explicit AbstractExpression(const SourcePosition& sourcePosition):sourcePosition(sourcePosition) {}
+    explicit AbstractExpression(Kind kind, const SourcePosition& sourcePosition):kind(kind),sourcePosition(sourcePosition) {}
     virtual ~AbstractExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const=0;
-    static void iterateExpression(const std::vector<AbstractExpressionP>& list, const std::function<void(AbstractExpressionP)>& callback) {
-        for (auto e:list)
+    virtual std::string toILangStr() const = 0;
+
+    //calls visitor(const ConcreteExpression&) for the concrete type of expression
+    template<typename R, typename V> static R visit(const AbstractExpression& expression, V& visitor);
+    template<typename F> static void iterateExpression(const std::vector<AbstractExpressionP>& list, const F& callback) {
+        for (auto& e:list)
             iterateExpression(e, callback);
     }
-    static void iterateExpression(AbstractExpressionP expression, const std::function<void(AbstractExpressionP)>& callback) {
-        if (!expression)
-            return;
-        callback(expression);
-        expression->iterateChildExpressions(callback);
-    }
-    static AbstractExpressionP mapExpression(AbstractExpressionP expression, const std::function<AbstractExpressionP(AbstractExpressionP)>& callback, bool *modifiedMarker=nullptr) {
-        if (!expression)
-            return AbstractExpressionP();
-        auto inner = expression->mapChildExpressions(callback); //returns nullptr iff no change
-        auto res = callback(inner ? inner : expression);
-        if (res != expression && modifiedMarker)
-            *modifiedMarker = true;
-        return res;
-    }
-    static std::vector<AbstractExpressionP> mapExpression(const std::vector<AbstractExpressionP>& lst, const std::function<AbstractExpressionP(AbstractExpressionP)>& callback, bool *modifiedMarker=nullptr) {
+    template<typename F> static void iterateExpression(const AbstractExpressionP& expression, const F& callback);
+    template<typename F> static AbstractExpressionP mapExpression(const AbstractExpressionP& expression, const F& callback, bool *modifiedMarker=nullptr);
+    template<typename F> static std::vector<AbstractExpressionP> mapExpression(const std::vector<AbstractExpressionP>& lst, const F& callback, bool *modifiedMarker=nullptr) {
         std::vector<AbstractExpressionP> lstNew(lst.size());
         for (unsigned int i=0; i<lst.size(); ++i)
             lstNew[i] = mapExpression(lst[i],callback,modifiedMarker);
         return lstNew;
     }
-    virtual std::string toILangStr() const = 0;
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const=0;
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const=0;
 };
 typedef std::shared_ptr<AbstractExpression> AbstractExpressionP;
 
@@ -69,15 +72,24 @@ public:
         Long=2
     };
 
+    enum Kind {
+        NamedVariable,
+        DirectMemoryVariable,
+        SpecialPurposeVariable,
+        CogRegisterVariable
+    };
+
+    const Kind kind;
     const SourcePosition sourcePosition;
     const SizeModifier size;
-    AbstractSpinVariable(const SourcePosition& sourcePosition, SizeModifier size):sourcePosition(sourcePosition),size(size) {}
+    AbstractSpinVariable(Kind kind, const SourcePosition& sourcePosition, SizeModifier size):kind(kind),sourcePosition(sourcePosition),size(size) {}
     virtual ~AbstractSpinVariable() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, VariableOperation operation) const=0;
     virtual bool canTakeReference() const=0;
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const=0;
-    virtual AbstractSpinVariableP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const=0;
     virtual std::string toILangStr() const=0;
+    template<typename R, typename V> static R visit(const AbstractSpinVariable& variable, V& visitor);
+    template<typename F> static void iterateVariable(const AbstractSpinVariableP& variable, const F& callback);
+    template<typename F> static AbstractSpinVariableP mapVariable(const AbstractSpinVariableP& variable, const F& callback); //returns nullptr iff no change
     std::string sizeToILangStr() const {
         switch(size) {
             case Byte: return "byte";
@@ -94,7 +106,7 @@ struct NamedSpinVariable : public AbstractSpinVariable {
     const AbstractExpressionP indexExpression; //might be nullptr
     const int symbolId;
 
-    explicit NamedSpinVariable(const SourcePosition& sourcePosition, SizeModifier size, VarType varType, AbstractExpressionP indexExpression, int symbolId):AbstractSpinVariable(sourcePosition,size),varType(varType),indexExpression(indexExpression),symbolId(symbolId) {}
+    explicit NamedSpinVariable(const SourcePosition& sourcePosition, SizeModifier size, VarType varType, AbstractExpressionP indexExpression, int symbolId):AbstractSpinVariable(NamedVariable, sourcePosition,size),varType(varType),indexExpression(indexExpression),symbolId(symbolId) {}
     virtual ~NamedSpinVariable() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, VariableOperation operation) const {
         if (indexExpression)
@@ -110,15 +122,15 @@ struct NamedSpinVariable : public AbstractSpinVariable {
     virtual bool canTakeReference() const {
         return true;
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(indexExpression, callback);
     }
-    virtual AbstractSpinVariableP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractSpinVariableP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto newIndexExpr = AbstractExpression::mapExpression(indexExpression, callback, &modified);
         if (!modified)
             return AbstractSpinVariableP(); //nullptr means no change
-        return AbstractSpinVariableP(new NamedSpinVariable(sourcePosition, size, varType, newIndexExpr, symbolId));
+        return AstArena::create<NamedSpinVariable>(sourcePosition, size, varType, newIndexExpr, symbolId);
     }
     virtual std::string toILangStr() const {
         std::string result;
@@ -138,7 +150,7 @@ struct DirectMemorySpinVariable : public AbstractSpinVariable {
     const AbstractExpressionP dynamicAddressExpression;
     const AbstractExpressionP indexExpression; //might be nullptr
 
-    explicit DirectMemorySpinVariable(const SourcePosition& sourcePosition, SizeModifier size, AbstractExpressionP dynamicAddressExpression, AbstractExpressionP indexExpression):AbstractSpinVariable(sourcePosition,size),dynamicAddressExpression(dynamicAddressExpression),indexExpression(indexExpression) {}
+    explicit DirectMemorySpinVariable(const SourcePosition& sourcePosition, SizeModifier size, AbstractExpressionP dynamicAddressExpression, AbstractExpressionP indexExpression):AbstractSpinVariable(DirectMemoryVariable, sourcePosition,size),dynamicAddressExpression(dynamicAddressExpression),indexExpression(indexExpression) {}
     virtual ~DirectMemorySpinVariable() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, VariableOperation operation) const {
         dynamicAddressExpression->generate(byteCodeWriter, false);
@@ -149,17 +161,17 @@ struct DirectMemorySpinVariable : public AbstractSpinVariable {
     virtual bool canTakeReference() const {
         return true;
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(dynamicAddressExpression, callback);
         AbstractExpression::iterateExpression(indexExpression, callback);
     }
-    virtual AbstractSpinVariableP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractSpinVariableP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto newAddressExpr = AbstractExpression::mapExpression(dynamicAddressExpression, callback, &modified);
         auto newIndexExpr = AbstractExpression::mapExpression(indexExpression, callback, &modified);
         if (!modified)
             return AbstractSpinVariableP(); //nullptr means no change
-        return AbstractSpinVariableP(new DirectMemorySpinVariable(sourcePosition, size, newAddressExpr, newIndexExpr));
+        return AstArena::create<DirectMemorySpinVariable>(sourcePosition, size, newAddressExpr, newIndexExpr);
     }
 
     virtual std::string toILangStr() const {
@@ -173,24 +185,24 @@ struct DirectMemorySpinVariable : public AbstractSpinVariable {
 struct SpecialPurposeSpinVariable : public AbstractSpinVariable {
     const AbstractExpressionP dynamicAddressExpression;
 
-    explicit SpecialPurposeSpinVariable(const SourcePosition& sourcePosition, AbstractExpressionP dynamicAddressExpression):AbstractSpinVariable(sourcePosition,SizeModifier::Long),dynamicAddressExpression(dynamicAddressExpression) {}
+    explicit SpecialPurposeSpinVariable(const SourcePosition& sourcePosition, AbstractExpressionP dynamicAddressExpression):AbstractSpinVariable(SpecialPurposeVariable, sourcePosition,SizeModifier::Long),dynamicAddressExpression(dynamicAddressExpression) {}
     virtual ~SpecialPurposeSpinVariable() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, VariableOperation operation) const {
         dynamicAddressExpression->generate(byteCodeWriter, false);
         byteCodeWriter.appendStaticByte(0x24 | operation);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(dynamicAddressExpression, callback);
     }
     virtual bool canTakeReference() const {
         return false;
     }
-    virtual AbstractSpinVariableP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractSpinVariableP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto newAddressExpr = AbstractExpression::mapExpression(dynamicAddressExpression, callback, &modified);
         if (!modified)
             return AbstractSpinVariableP(); //nullptr means no change
-        return AbstractSpinVariableP(new SpecialPurposeSpinVariable(sourcePosition, newAddressExpr));
+        return AstArena::create<SpecialPurposeSpinVariable>(sourcePosition, newAddressExpr);
     }
     virtual std::string toILangStr() const {
         return "spr "+dynamicAddressExpression->toILangStr();
@@ -202,7 +214,7 @@ struct CogRegisterSpinVariable : public AbstractSpinVariable {
     const AbstractExpressionP indexExpression; //might be nullptr
     const AbstractExpressionP indexExpressionUpperRange; //might be nullptr
 
-    explicit CogRegisterSpinVariable(const SourcePosition& sourcePosition, int cogRegister, AbstractExpressionP indexExpression, AbstractExpressionP indexExpressionUpperRange):AbstractSpinVariable(sourcePosition, SizeModifier::Long),cogRegister(cogRegister),indexExpression(indexExpression),indexExpressionUpperRange(indexExpressionUpperRange) {}
+    explicit CogRegisterSpinVariable(const SourcePosition& sourcePosition, int cogRegister, AbstractExpressionP indexExpression, AbstractExpressionP indexExpressionUpperRange):AbstractSpinVariable(CogRegisterVariable, sourcePosition, SizeModifier::Long),cogRegister(cogRegister),indexExpression(indexExpression),indexExpressionUpperRange(indexExpressionUpperRange) {}
     virtual ~CogRegisterSpinVariable() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, VariableOperation operation) const {
         if (indexExpression) {
@@ -222,17 +234,17 @@ struct CogRegisterSpinVariable : public AbstractSpinVariable {
     virtual bool canTakeReference() const {
         return false;
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(indexExpression, callback);
         AbstractExpression::iterateExpression(indexExpressionUpperRange, callback);
     }
-    virtual AbstractSpinVariableP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractSpinVariableP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto newIndexExpr = AbstractExpression::mapExpression(indexExpression, callback, &modified);
         auto newIndexUpperExpr = AbstractExpression::mapExpression(indexExpressionUpperRange, callback, &modified);
         if (!modified)
             return AbstractSpinVariableP(); //nullptr means no change
-        return AbstractSpinVariableP(new CogRegisterSpinVariable(sourcePosition, cogRegister, newIndexExpr, newIndexUpperExpr));
+        return AstArena::create<CogRegisterSpinVariable>(sourcePosition, cogRegister, newIndexExpr, newIndexUpperExpr);
     }
     virtual std::string toILangStr() const {
         std::string result = "cogreg "+std::to_string(cogRegister);
@@ -250,7 +262,7 @@ public:
     const bool isReadReference;
 
     explicit VariableExpression(AbstractSpinVariableP variable, bool isReadReference):
-        AbstractExpression(variable->sourcePosition),variable(variable),isReadReference(isReadReference) {
+        AbstractExpression(VariableNode, variable->sourcePosition),variable(variable),isReadReference(isReadReference) {
     }
     virtual ~VariableExpression() {}
 
@@ -264,15 +276,14 @@ public:
             return "(refvar "+variable->toILangStr()+")";
         return "(rdvar "+variable->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
-        variable->iterateChildExpressions(callback);
+    template<typename F> void iterateChildExpressions(const F& callback) const {
+        AbstractSpinVariable::iterateVariable(variable, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
-        auto newVarInfo = variable->mapChildExpressions(callback);
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
+        auto newVarInfo = AbstractSpinVariable::mapVariable(variable, callback);
         if (!newVarInfo)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new VariableExpression(newVarInfo, isReadReference));
+        return AstArena::create<VariableExpression>(newVarInfo, isReadReference);
     }
 };
 
@@ -282,7 +293,7 @@ public:
     const int vOperator;
 
     explicit UnaryAssignExpression(AbstractSpinVariableP variable, int vOperator):
-        AbstractExpression(variable->sourcePosition),variable(variable),vOperator(vOperator) {
+        AbstractExpression(UnaryAssignNode, variable->sourcePosition),variable(variable),vOperator(vOperator) {
     }
     virtual ~UnaryAssignExpression() {}
 
@@ -293,15 +304,14 @@ public:
     virtual std::string toILangStr() const {
         return "(modvar "+std::to_string(vOperator)+" "+variable->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
-        variable->iterateChildExpressions(callback);
+    template<typename F> void iterateChildExpressions(const F& callback) const {
+        AbstractSpinVariable::iterateVariable(variable, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
-        auto newVarInfo = variable->mapChildExpressions(callback);
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
+        auto newVarInfo = AbstractSpinVariable::mapVariable(variable, callback);
         if (!newVarInfo)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new UnaryAssignExpression(newVarInfo, vOperator));
+        return AstArena::create<UnaryAssignExpression>(newVarInfo, vOperator);
     }
 };
 
@@ -312,7 +322,7 @@ public:
     const OperatorType::Type operation; //None if just assign
 
     explicit AssignExpression(const SourcePosition& sourcePosition, AbstractExpressionP valueExpression, AbstractSpinVariableP variable, OperatorType::Type operation):
-        AbstractExpression(sourcePosition),valueExpression(valueExpression),variable(variable),operation(operation) {}
+        AbstractExpression(AssignNode, sourcePosition),valueExpression(valueExpression),variable(variable),operation(operation) {}
     virtual ~AssignExpression() {}
 
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
@@ -332,18 +342,17 @@ public:
         std::string result = operation != OperatorType::None ? "(assignop "+OperatorType::toString(operation)+" " : "(assign ";
         return result + variable->toILangStr() + " " + valueExpression->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(valueExpression, callback);
-        variable->iterateChildExpressions(callback);
+        AbstractSpinVariable::iterateVariable(variable, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto valueExpressionNew = mapExpression(valueExpression, callback, &modified);
-        auto newVarInfo = variable->mapChildExpressions(callback);
+        auto newVarInfo = AbstractSpinVariable::mapVariable(variable, callback);
         if (!newVarInfo && !modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new AssignExpression(sourcePosition, valueExpressionNew, newVarInfo ? newVarInfo : variable, operation));
+        return AstArena::create<AssignExpression>(sourcePosition, valueExpressionNew, newVarInfo ? newVarInfo : variable, operation);
     }
 };
 
@@ -354,7 +363,7 @@ public:
     const MethodId methodId;
 
     explicit CogNewSpinExpression(const SourcePosition& sourcePosition, const std::vector<AbstractExpressionP> &parameters, AbstractExpressionP stackExpression, MethodId methodId):
-        AbstractExpression(sourcePosition),parameters(parameters),stackExpression(stackExpression),methodId(methodId) {}
+        AbstractExpression(CogNewSpinNode, sourcePosition),parameters(parameters),stackExpression(stackExpression),methodId(methodId) {}
     virtual ~CogNewSpinExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         for (auto p:parameters)
@@ -371,18 +380,17 @@ public:
         result += ")";
         return result;
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(parameters, callback);
         iterateExpression(stackExpression, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto parametersNew = mapExpression(parameters, callback, &modified);
         auto stackExpressionNew = mapExpression(stackExpression, callback, &modified);
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new CogNewSpinExpression(sourcePosition, parametersNew, stackExpressionNew, methodId));
+        return AstArena::create<CogNewSpinExpression>(sourcePosition, parametersNew, stackExpressionNew, methodId);
     }
 };
 
@@ -392,7 +400,7 @@ public:
     const AbstractExpressionP startParameter;
 
     explicit CogNewAsmExpression(const SourcePosition& sourcePosition, AbstractExpressionP address, AbstractExpressionP startParameter):
-        AbstractExpression(sourcePosition),address(address),startParameter(startParameter) {}
+        AbstractExpression(CogNewAsmNode, sourcePosition),address(address),startParameter(startParameter) {}
     virtual ~CogNewAsmExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         byteCodeWriter.appendStaticByte(0x34); // constant -1
@@ -403,18 +411,17 @@ public:
     virtual std::string toILangStr() const {
         return "(cogNewAsm "+address->toILangStr()+" "+startParameter->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(address, callback);
         iterateExpression(startParameter, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto addressNew = mapExpression(address, callback, &modified);
         auto startParameterNew = mapExpression(startParameter, callback, &modified);
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new CogNewAsmExpression(sourcePosition, addressNew, startParameterNew));
+        return AstArena::create<CogNewAsmExpression>(sourcePosition, addressNew, startParameterNew);
     }
 };
 
@@ -428,7 +435,7 @@ public:
 
 
     explicit MethodCallExpression(const SourcePosition& sourcePosition, const std::vector<AbstractExpressionP> &parameters, AbstractExpressionP objectIndex, ObjectInstanceId objectInstanceId, MethodId methodId, bool trapCall):
-        AbstractExpression(sourcePosition),parameters(parameters),objectIndex(objectIndex),objectInstanceId(objectInstanceId),methodId(methodId),trapCall(trapCall) {}
+        AbstractExpression(MethodCallNode, sourcePosition),parameters(parameters),objectIndex(objectIndex),objectInstanceId(objectInstanceId),methodId(methodId),trapCall(trapCall) {}
     virtual ~MethodCallExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         byteCodeWriter.appendStaticByte((trapCall ? 2 : 0) | (removeResultFromStack ? 1 : 0)); // drop anchor (0..3 return/exception value handling)
@@ -460,18 +467,17 @@ public:
         }
         return callType+paramstr+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(parameters, callback);
         iterateExpression(objectIndex, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto parametersNew = mapExpression(parameters, callback, &modified);
         auto objectIndexNew = mapExpression(objectIndex, callback, &modified);
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new MethodCallExpression(sourcePosition, parametersNew, objectIndexNew, objectInstanceId, methodId, trapCall));
+        return AstArena::create<MethodCallExpression>(sourcePosition, parametersNew, objectIndexNew, objectInstanceId, methodId, trapCall);
     }
 };
 
@@ -488,7 +494,7 @@ public:
     const int origTokenByteCode; //TODO
 
     explicit LookExpression(const SourcePosition& sourcePosition, AbstractExpressionP condition, const std::vector<ExpressionListEntry> &expressionList, int origTokenByteCode):
-        AbstractExpression(sourcePosition),condition(condition),expressionList(expressionList),origTokenByteCode(origTokenByteCode) {}
+        AbstractExpression(LookNode, sourcePosition),condition(condition),expressionList(expressionList),origTokenByteCode(origTokenByteCode) {}
     virtual ~LookExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         SpinByteCodeLabel label = byteCodeWriter.reserveLabel();
@@ -512,15 +518,14 @@ public:
     virtual std::string toILangStr() const {
         return "(look todo)"; //TODO
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(condition, callback);
         for (const auto&e: expressionList) {
             iterateExpression(e.expr1, callback);
             iterateExpression(e.expr2, callback);
         }
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto conditionNew = mapExpression(condition, callback, &modified);
         std::vector<ExpressionListEntry>expressionListNew(expressionList.size());
@@ -530,7 +535,7 @@ protected:
         }
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new LookExpression(sourcePosition, conditionNew, expressionListNew, origTokenByteCode));
+        return AstArena::create<LookExpression>(sourcePosition, conditionNew, expressionListNew, origTokenByteCode);
     }
 };
 
@@ -538,8 +543,8 @@ class PushConstantExpression : public AbstractExpression {
 public:
     const AbstractConstantExpressionP constant;
     const ConstantEncoding encoding;
-    explicit PushConstantExpression(const SourcePosition& sourcePosition, AbstractConstantExpressionP constant, ConstantEncoding encoding):AbstractExpression(sourcePosition),constant(constant),encoding(encoding) {}
-    explicit PushConstantExpression(const SourcePosition& sourcePosition, int value, ConstantEncoding encoding):AbstractExpression(sourcePosition),constant(ConstantValueExpression::create(sourcePosition,value)),encoding(encoding) {}
+    explicit PushConstantExpression(const SourcePosition& sourcePosition, AbstractConstantExpressionP constant, ConstantEncoding encoding):AbstractExpression(PushConstantNode, sourcePosition),constant(constant),encoding(encoding) {}
+    explicit PushConstantExpression(const SourcePosition& sourcePosition, int value, ConstantEncoding encoding):AbstractExpression(PushConstantNode, sourcePosition),constant(ConstantValueExpression::create(sourcePosition,value)),encoding(encoding) {}
     virtual ~PushConstantExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         byteCodeWriter.appendStaticPushConstant(sourcePosition, constant, encoding);
@@ -552,10 +557,9 @@ public:
             return std::to_string(c);
         return "(con "+constant->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>&) const {
+    template<typename F> void iterateChildExpressions(const F&) const {
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>&) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F&) const {
         return AbstractExpressionP(); //nullptr means no change
     }
 };
@@ -567,7 +571,7 @@ public:
     //the index will be incremented by the parse (reset to 0 for each function)
     //if this index is negative (e.g. -1) ordering of strings in the binary might be arbitrary
     const int stringIndex;
-    explicit PushStringExpression(const SourcePosition& sourcePosition, const std::vector<AbstractConstantExpressionP> &stringData, int stringIndex):AbstractExpression(sourcePosition),stringData(stringData),stringIndex(stringIndex) {}
+    explicit PushStringExpression(const SourcePosition& sourcePosition, const std::vector<AbstractConstantExpressionP> &stringData, int stringIndex):AbstractExpression(PushStringNode, sourcePosition),stringData(stringData),stringIndex(stringIndex) {}
     virtual ~PushStringExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         byteCodeWriter.appendStaticByte(0x87); // (memcp byte+pbase+address)
@@ -578,10 +582,9 @@ public:
     virtual std::string toILangStr() const {
         return "(pushstr todo )"; //TODO
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>&) const {
+    template<typename F> void iterateChildExpressions(const F&) const {
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>&) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F&) const {
         return AbstractExpressionP(); //nullptr means no change
     }
 };
@@ -590,7 +593,7 @@ class CallBuiltInExpression : public AbstractExpression {
 public:
     const std::vector<AbstractExpressionP> parameters;
     const BuiltInFunction::Type builtInFunction;
-    explicit CallBuiltInExpression(const SourcePosition& sourcePosition, const std::vector<AbstractExpressionP> &parameters, BuiltInFunction::Type builtInFunction):AbstractExpression(sourcePosition),parameters(parameters),builtInFunction(builtInFunction) {}
+    explicit CallBuiltInExpression(const SourcePosition& sourcePosition, const std::vector<AbstractExpressionP> &parameters, BuiltInFunction::Type builtInFunction):AbstractExpression(CallBuiltInNode, sourcePosition),parameters(parameters),builtInFunction(builtInFunction) {}
     virtual ~CallBuiltInExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         for (auto p:parameters)
@@ -612,16 +615,15 @@ public:
             result += " "+p->toILangStr();
         return result;
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(parameters, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto parametersNew = mapExpression(parameters, callback, &modified);
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new CallBuiltInExpression(sourcePosition, parametersNew, builtInFunction));
+        return AstArena::create<CallBuiltInExpression>(sourcePosition, parametersNew, builtInFunction);
     }
 };
 
@@ -629,7 +631,7 @@ class UnaryExpression : public AbstractExpression {
 public:
     const AbstractExpressionP expression;
     const OperatorType::Type operation;
-    explicit UnaryExpression(const SourcePosition& sourcePosition, AbstractExpressionP expression, OperatorType::Type operation):AbstractExpression(sourcePosition),expression(expression),operation(operation) {}
+    explicit UnaryExpression(const SourcePosition& sourcePosition, AbstractExpressionP expression, OperatorType::Type operation):AbstractExpression(UnaryNode, sourcePosition),expression(expression),operation(operation) {}
     virtual ~UnaryExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         expression->generate(byteCodeWriter, false);
@@ -640,16 +642,15 @@ public:
     virtual std::string toILangStr() const {
         return "("+OperatorType::toString(operation)+" "+expression->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(expression, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto expressionNew = mapExpression(expression, callback, &modified);
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new UnaryExpression(sourcePosition, expressionNew, operation));
+        return AstArena::create<UnaryExpression>(sourcePosition, expressionNew, operation);
     }
 };
 
@@ -658,7 +659,7 @@ public:
     const AbstractExpressionP left;
     const AbstractExpressionP right;
     const OperatorType::Type operation;
-    explicit BinaryExpression(const SourcePosition& sourcePosition, AbstractExpressionP left, AbstractExpressionP right, OperatorType::Type operation):AbstractExpression(sourcePosition),left(left),right(right),operation(operation) {}
+    explicit BinaryExpression(const SourcePosition& sourcePosition, AbstractExpressionP left, AbstractExpressionP right, OperatorType::Type operation):AbstractExpression(BinaryNode, sourcePosition),left(left),right(right),operation(operation) {}
     virtual ~BinaryExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         left->generate(byteCodeWriter, false);
@@ -670,25 +671,24 @@ public:
     virtual std::string toILangStr() const {
         return "("+OperatorType::toString(operation)+" "+left->toILangStr()+" "+right->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(left, callback);
         iterateExpression(right, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto leftNew = mapExpression(left, callback, &modified);
         auto rightNew = mapExpression(right, callback, &modified);
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new BinaryExpression(sourcePosition, leftNew, rightNew, operation));
+        return AstArena::create<BinaryExpression>(sourcePosition, leftNew, rightNew, operation);
     }
 };
 
 class AtAtExpression : public AbstractExpression {
 public:
     const AbstractExpressionP expression;
-    explicit AtAtExpression(const SourcePosition& sourcePosition, AbstractExpressionP expression):AbstractExpression(sourcePosition),expression(expression) {}
+    explicit AtAtExpression(const SourcePosition& sourcePosition, AbstractExpressionP expression):AbstractExpression(AtAtNode, sourcePosition),expression(expression) {}
     virtual ~AtAtExpression() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, bool removeResultFromStack) const {
         expression->generate(byteCodeWriter, false);
@@ -700,19 +700,93 @@ public:
     virtual std::string toILangStr() const {
         return "(atat "+expression->toILangStr()+")";
     }
-protected:
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         iterateExpression(expression, callback);
     }
-    virtual AbstractExpressionP mapChildExpressions(const std::function<AbstractExpressionP(AbstractExpressionP)>& callback) const {
+    template<typename F> AbstractExpressionP mapChildExpressions(const F& callback) const {
         bool modified=false;
         auto expressionNew = mapExpression(expression, callback, &modified);
         if (!modified)
             return AbstractExpressionP(); //nullptr means no change
-        return AbstractExpressionP(new AtAtExpression(sourcePosition, expressionNew));
+        return AstArena::create<AtAtExpression>(sourcePosition, expressionNew);
     }
 };
 
+namespace AstVisitorDetail {
+    template<typename F> struct ChildExpressionIterator {
+        const F& callback;
+        explicit ChildExpressionIterator(const F& callback):callback(callback) {}
+        template<typename T> void operator()(const T& node) const {
+            node.iterateChildExpressions(callback);
+        }
+    };
+    template<typename F, typename P> struct ChildExpressionMapper {
+        const F& callback;
+        explicit ChildExpressionMapper(const F& callback):callback(callback) {}
+        template<typename T> P operator()(const T& node) const {
+            return node.mapChildExpressions(callback);
+        }
+    };
+}
+
+template<typename R, typename V> inline R AbstractSpinVariable::visit(const AbstractSpinVariable& variable, V& visitor) {
+    switch(variable.kind) {
+        case NamedVariable: return visitor(static_cast<const NamedSpinVariable&>(variable));
+        case DirectMemoryVariable: return visitor(static_cast<const DirectMemorySpinVariable&>(variable));
+        case SpecialPurposeVariable: return visitor(static_cast<const SpecialPurposeSpinVariable&>(variable));
+        case CogRegisterVariable: break;
+    }
+    return visitor(static_cast<const CogRegisterSpinVariable&>(variable));
+}
+
+template<typename F> inline void AbstractSpinVariable::iterateVariable(const AbstractSpinVariableP& variable, const F& callback) {
+    const AstVisitorDetail::ChildExpressionIterator<F> iterator(callback);
+    visit<void>(*variable, iterator);
+}
+
+template<typename F> inline AbstractSpinVariableP AbstractSpinVariable::mapVariable(const AbstractSpinVariableP& variable, const F& callback) {
+    const AstVisitorDetail::ChildExpressionMapper<F,AbstractSpinVariableP> mapper(callback);
+    return visit<AbstractSpinVariableP>(*variable, mapper);
+}
+
+template<typename R, typename V> inline R AbstractExpression::visit(const AbstractExpression& expression, V& visitor) {
+    switch(expression.kind) {
+        case VariableNode: return visitor(static_cast<const VariableExpression&>(expression));
+        case UnaryAssignNode: return visitor(static_cast<const UnaryAssignExpression&>(expression));
+        case AssignNode: return visitor(static_cast<const AssignExpression&>(expression));
+        case CogNewSpinNode: return visitor(static_cast<const CogNewSpinExpression&>(expression));
+        case CogNewAsmNode: return visitor(static_cast<const CogNewAsmExpression&>(expression));
+        case MethodCallNode: return visitor(static_cast<const MethodCallExpression&>(expression));
+        case LookNode: return visitor(static_cast<const LookExpression&>(expression));
+        case PushConstantNode: return visitor(static_cast<const PushConstantExpression&>(expression));
+        case PushStringNode: return visitor(static_cast<const PushStringExpression&>(expression));
+        case CallBuiltInNode: return visitor(static_cast<const CallBuiltInExpression&>(expression));
+        case UnaryNode: return visitor(static_cast<const UnaryExpression&>(expression));
+        case BinaryNode: return visitor(static_cast<const BinaryExpression&>(expression));
+        case AtAtNode: break;
+    }
+    return visitor(static_cast<const AtAtExpression&>(expression));
+}
+
+template<typename F> inline void AbstractExpression::iterateExpression(const AbstractExpressionP& expression, const F& callback) {
+    if (!expression)
+        return;
+    callback(expression);
+    const AstVisitorDetail::ChildExpressionIterator<F> iterator(callback);
+    visit<void>(*expression, iterator);
+}
+
+template<typename F> inline AbstractExpressionP AbstractExpression::mapExpression(const AbstractExpressionP& expression, const F& callback, bool *modifiedMarker) {
+    if (!expression)
+        return AbstractExpressionP();
+    const AstVisitorDetail::ChildExpressionMapper<F,AbstractExpressionP> mapper(callback);
+    auto inner = visit<AbstractExpressionP>(*expression, mapper); //returns nullptr iff no change
+    auto res = callback(inner ? inner : expression);
+    if (res != expression && modifiedMarker)
+        *modifiedMarker = true;
+    return res;
+}
+
 #endif //SPINCOMPILER_EXPRESSION_H
 
 ///////////////////////////////////////////////////////////////////////////////////////////
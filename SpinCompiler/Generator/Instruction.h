@@ -52,51 +52,52 @@ struct InstructionLoopContext {
 typedef std::shared_ptr<class AbstractInstruction> AbstractInstructionP;
 class AbstractInstruction {
 public:
+    //node type tag, traversals switch on it instead of virtual calls or casts
+    enum Kind {
+        ExpressionNode,
+        CogInitSpinNode,
+        CogInitAsmNode,
+        AbortOrReturnNode,
+        NextOrQuitNode,
+        CallBuiltInNode,
+        BlockNode,
+        IfNode,
+        CaseNode,
+        LoopConditionNode,
+        LoopVarNode
+    };
+    const Kind kind;
     const SourcePosition sourcePosition;
-    explicit AbstractInstruction(const SourcePosition &sourcePosition):sourcePosition(sourcePosition) {}
+    explicit AbstractInstruction(Kind kind, const SourcePosition &sourcePosition):kind(kind),sourcePosition(sourcePosition) {}
     virtual ~AbstractInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext& parentLoopContext) const=0;
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const=0;
-    static void iterateInstruction(AbstractInstructionP instruction, const std::function<void(AbstractInstructionP)>& callback) {
-        if (!instruction)
-            return;
-        callback(instruction);
-        instruction->iterateChildInstructions(callback);
-    }
-    static AbstractInstructionP mapInstruction(AbstractInstructionP instruction, const std::function<AbstractInstructionP(AbstractInstructionP)>& instrCallback, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback, bool *modifiedMarker=nullptr) {
-        if (!instruction)
-            return AbstractInstructionP();
-        auto inner = instruction->mapChildren(instrCallback,exprCallback); //returns nullptr iff no change
-        auto res = instrCallback(inner ? inner : instruction);
-        if (res != instruction && modifiedMarker)
-            *modifiedMarker = true;
-        return res;
-    }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>& callback) const=0;
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>& instrCallback, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback)=0;
+
+    //calls visitor(const ConcreteInstruction&) for the concrete type of instruction
+    template<typename R, typename V> static R visit(const AbstractInstruction& instruction, V& visitor);
+    template<typename F> static void iterateInstructionExpressions(const AbstractInstructionP& instruction, const F& callback);
+    template<typename F> static void iterateInstruction(const AbstractInstructionP& instruction, const F& callback);
+    template<typename FI, typename FE> static AbstractInstructionP mapInstruction(const AbstractInstructionP& instruction, const FI& instrCallback, const FE& exprCallback, bool *modifiedMarker=nullptr);
 };
 
 class ExpressionInstruction : public AbstractInstruction {
 public:
     const AbstractExpressionP expression;
-    explicit ExpressionInstruction(AbstractExpressionP expression):AbstractInstruction(expression->sourcePosition),expression(expression) {}
+    explicit ExpressionInstruction(AbstractExpressionP expression):AbstractInstruction(ExpressionNode, expression->sourcePosition),expression(expression) {}
     virtual ~ExpressionInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext&) const {
         expression->generate(byteCodeWriter, true);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(expression, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>&) const {
+    template<typename F> void iterateChildInstructions(const F&) const {
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>&, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI&, const FE& exprCallback) const {
         bool modified = false;
         auto expressionNew = AbstractExpression::mapExpression(expression, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new ExpressionInstruction(expressionNew));
+        return AstArena::create<ExpressionInstruction>(expressionNew);
     }
 };
 
@@ -108,7 +109,7 @@ public:
     const MethodId methodId;
 
     explicit CogInitSpinInstruction(const SourcePosition& sourcePosition, const std::vector<AbstractExpressionP> &parameters, AbstractExpressionP cogIdExpression, AbstractExpressionP stackExpression, MethodId methodId):
-        AbstractInstruction(sourcePosition),parameters(parameters),cogIdExpression(cogIdExpression),stackExpression(stackExpression),methodId(methodId) {}
+        AbstractInstruction(CogInitSpinNode, sourcePosition),parameters(parameters),cogIdExpression(cogIdExpression),stackExpression(stackExpression),methodId(methodId) {}
 
     virtual ~CogInitSpinInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext&) const {
@@ -125,22 +126,21 @@ public:
         byteCodeWriter.appendStaticByte(0xD1); // write long[base][index]
         byteCodeWriter.appendStaticByte(0x2C); // coginit
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(parameters, callback);
         AbstractExpression::iterateExpression(cogIdExpression, callback);
         AbstractExpression::iterateExpression(stackExpression, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>&) const {
+    template<typename F> void iterateChildInstructions(const F&) const {
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>&, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI&, const FE& exprCallback) const {
         bool modified = false;
         auto parametersNew = AbstractExpression::mapExpression(parameters, exprCallback, &modified);
         auto cogIdExpressionNew = AbstractExpression::mapExpression(cogIdExpression, exprCallback, &modified);
         auto stackExpressionNew = AbstractExpression::mapExpression(stackExpression, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new CogInitSpinInstruction(sourcePosition, parametersNew, cogIdExpressionNew, stackExpressionNew, methodId));
+        return AstArena::create<CogInitSpinInstruction>(sourcePosition, parametersNew, cogIdExpressionNew, stackExpressionNew, methodId);
     }
 };
 
@@ -151,7 +151,7 @@ public:
     const AbstractExpressionP startParameter;
 
     explicit CogInitAsmInstruction(const SourcePosition& sourcePosition, AbstractExpressionP cogId, AbstractExpressionP address, AbstractExpressionP startParameter):
-        AbstractInstruction(sourcePosition),cogId(cogId),address(address),startParameter(startParameter) {}
+        AbstractInstruction(CogInitAsmNode, sourcePosition),cogId(cogId),address(address),startParameter(startParameter) {}
     virtual ~CogInitAsmInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext&) const {
         cogId->generate(byteCodeWriter, false);
@@ -159,22 +159,21 @@ public:
         startParameter->generate(byteCodeWriter, false);
         byteCodeWriter.appendStaticByte(0x2C);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(cogId, callback);
         AbstractExpression::iterateExpression(address, callback);
         AbstractExpression::iterateExpression(startParameter, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>&) const {
+    template<typename F> void iterateChildInstructions(const F&) const {
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>&, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI&, const FE& exprCallback) const {
         bool modified = false;
         auto cogIdNew = AbstractExpression::mapExpression(cogId, exprCallback, &modified);
         auto addressNew = AbstractExpression::mapExpression(address, exprCallback, &modified);
         auto startParameterNew = AbstractExpression::mapExpression(startParameter, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new CogInitAsmInstruction(sourcePosition, cogIdNew, addressNew, startParameterNew));
+        return AstArena::create<CogInitAsmInstruction>(sourcePosition, cogIdNew, addressNew, startParameterNew);
     }
 };
 
@@ -184,7 +183,7 @@ public:
     const int isAbort;
 
     explicit AbortOrReturnInstruction(const SourcePosition& sourcePosition, AbstractExpressionP returnValue, bool isAbort):
-        AbstractInstruction(sourcePosition),returnValue(returnValue),isAbort(isAbort) {}
+        AbstractInstruction(AbortOrReturnNode, sourcePosition),returnValue(returnValue),isAbort(isAbort) {}
     virtual ~AbortOrReturnInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext&) const {
         if (returnValue) {
@@ -194,18 +193,17 @@ public:
         else
             byteCodeWriter.appendStaticByte(isAbort ? 0X30 : 0X32);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(returnValue, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>&) const {
+    template<typename F> void iterateChildInstructions(const F&) const {
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>&, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI&, const FE& exprCallback) const {
         bool modified = false;
         auto returnValueNew = AbstractExpression::mapExpression(returnValue, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new AbortOrReturnInstruction(sourcePosition, returnValueNew, isAbort));
+        return AstArena::create<AbortOrReturnInstruction>(sourcePosition, returnValueNew, isAbort);
     }
 };
 
@@ -214,7 +212,7 @@ public:
     const bool isNext;
 
     explicit NextOrQuitInstruction(const SourcePosition& sourcePosition, bool isNext):
-        AbstractInstruction(sourcePosition),isNext(isNext) {}
+        AbstractInstruction(NextOrQuitNode, sourcePosition),isNext(isNext) {}
     virtual ~NextOrQuitInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext& parentLoopContext) const {
         if (parentLoopContext.type == InstructionLoopContext::NoLoop)
@@ -226,12 +224,11 @@ public:
         byteCodeWriter.appendStaticByte(isNext ? 0x04 : (parentLoopContext.type == InstructionLoopContext::RepeatCountLoop ? 0x0B : 0x04)); // jmp 'next' otherwise jnz/jmp 'quit'
         byteCodeWriter.appendRelativeAddress(isNext ? parentLoopContext.nextAddress : parentLoopContext.quitAddress);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>&) const {
+    template<typename F> void iterateChildExpressions(const F&) const {
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>&) const {
+    template<typename F> void iterateChildInstructions(const F&) const {
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>&, const std::function<AbstractExpressionP(AbstractExpressionP)>&) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI&, const FE&) const {
         return AbstractInstructionP(); //nullptr means no change
     }
 };
@@ -241,52 +238,50 @@ class CallBuiltInInstruction : public AbstractInstruction {
 public:
     const std::vector<AbstractExpressionP> parameters;
     const int opCode; //TODO
-    explicit CallBuiltInInstruction(const SourcePosition& sourcePosition, const std::vector<AbstractExpressionP> &parameters, int opCode):AbstractInstruction(sourcePosition),parameters(parameters),opCode(opCode) {}
+    explicit CallBuiltInInstruction(const SourcePosition& sourcePosition, const std::vector<AbstractExpressionP> &parameters, int opCode):AbstractInstruction(CallBuiltInNode, sourcePosition),parameters(parameters),opCode(opCode) {}
     virtual ~CallBuiltInInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext&) const {
         for (auto p:parameters)
             p->generate(byteCodeWriter, false);
         byteCodeWriter.appendStaticByte(opCode);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(parameters, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>&) const {
+    template<typename F> void iterateChildInstructions(const F&) const {
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>&, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI&, const FE& exprCallback) const {
         bool modified = false;
         auto parametersNew = AbstractExpression::mapExpression(parameters, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new CallBuiltInInstruction(sourcePosition, parametersNew, opCode));
+        return AstArena::create<CallBuiltInInstruction>(sourcePosition, parametersNew, opCode);
     }
 };
 
 class BlockInstruction : public AbstractInstruction {
 public:
     const std::vector<AbstractInstructionP> children;
-    explicit BlockInstruction(const SourcePosition& sourcePosition, const std::vector<AbstractInstructionP> &children):AbstractInstruction(sourcePosition),children(children) {}
+    explicit BlockInstruction(const SourcePosition& sourcePosition, const std::vector<AbstractInstructionP> &children):AbstractInstruction(BlockNode, sourcePosition),children(children) {}
     virtual ~BlockInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext& parentLoopContext) const {
         for (auto i:children)
             i->generate(byteCodeWriter, parentLoopContext);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>&) const {
+    template<typename F> void iterateChildExpressions(const F&) const {
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>& callback) const {
+    template<typename F> void iterateChildInstructions(const F& callback) const {
         for (const auto&c:children)
             iterateInstruction(c, callback);
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>& instrCallback, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI& instrCallback, const FE& exprCallback) const {
         bool modified = false;
         std::vector<AbstractInstructionP> childrenNew(children.size());
         for (unsigned int i=0; i<children.size(); ++i)
             childrenNew[i] = mapInstruction(children[i], instrCallback, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new BlockInstruction(sourcePosition, childrenNew));
+        return AstArena::create<BlockInstruction>(sourcePosition, childrenNew);
     }
 };
 typedef std::shared_ptr<BlockInstruction> BlockInstructionP;
@@ -302,7 +297,7 @@ public:
     };
     const std::vector<Branch> branches;
     AbstractInstructionP elseBranch; //might be nullptr
-    explicit IfInstruction(const SourcePosition& sourcePosition, const std::vector<Branch> &branches, AbstractInstructionP elseBranch):AbstractInstruction(sourcePosition),branches(branches),elseBranch(elseBranch) {}
+    explicit IfInstruction(const SourcePosition& sourcePosition, const std::vector<Branch> &branches, AbstractInstructionP elseBranch):AbstractInstruction(IfNode, sourcePosition),branches(branches),elseBranch(elseBranch) {}
     virtual ~IfInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext& parentLoopContext) const {
         //this label will be placed at the end after all if/elseif/else blocks
@@ -331,29 +326,28 @@ public:
         byteCodeWriter.placeLabelHere(nextIfBranchLabel);
         byteCodeWriter.placeLabelHere(endOfBlockLabel);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         for (auto b:branches)
             AbstractExpression::iterateExpression(b.condition, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>& callback) const {
+    template<typename F> void iterateChildInstructions(const F& callback) const {
         for (const auto&b:branches)
             iterateInstruction(b.instruction, callback);
         iterateInstruction(elseBranch, callback);
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>& instrCallback, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI& instrCallback, const FE& exprCallback) const {
         bool modified = false;
         std::vector<Branch> branchesNew(branches.size());
         for (unsigned int i=0; i<branches.size(); ++i) {
             branchesNew[i].instruction = mapInstruction(branches[i].instruction, instrCallback, exprCallback, &modified);
-            branchesNew[i].conditionInverted = branchesNew[i].conditionInverted;
+            branchesNew[i].conditionInverted = branches[i].conditionInverted;
             branchesNew[i].condition = AbstractExpression::mapExpression(branches[i].condition, exprCallback, &modified);
         }
 
         auto elseBranchNew = mapInstruction(elseBranch, instrCallback, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new IfInstruction(sourcePosition, branchesNew, elseBranchNew));
+        return AstArena::create<IfInstruction>(sourcePosition, branchesNew, elseBranchNew);
     }
 };
 
@@ -376,7 +370,7 @@ public:
     AbstractInstructionP otherInstruction; //might by nullptr
 
     explicit CaseInstruction(const SourcePosition& sourcePosition, AbstractExpressionP condition, const std::vector<CaseEntry> &cases, AbstractInstructionP otherInstruction):
-        AbstractInstruction(sourcePosition),condition(condition),cases(cases),otherInstruction(otherInstruction) {}
+        AbstractInstruction(CaseNode, sourcePosition),condition(condition),cases(cases),otherInstruction(otherInstruction) {}
     virtual ~CaseInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext& parentLoopContext) const {
         auto endLabel = byteCodeWriter.reserveLabel();
@@ -409,7 +403,7 @@ public:
         }
         byteCodeWriter.placeLabelHere(endLabel);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(condition, callback);
         for (const auto& cse:cases) {
             for (const auto& expr: cse.expressions) {
@@ -418,13 +412,12 @@ public:
             }
         }
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>& callback) const {
+    template<typename F> void iterateChildInstructions(const F& callback) const {
         for (const auto&c:cases)
             iterateInstruction(c.instruction, callback);
         iterateInstruction(otherInstruction, callback);
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>& instrCallback, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI& instrCallback, const FE& exprCallback) const {
         bool modified = false;
 
         auto otherInstructionNew = mapInstruction(otherInstruction, instrCallback, exprCallback, &modified);
@@ -434,14 +427,14 @@ protected:
         for (unsigned int i=0; i<cases.size(); ++i) {
             casesNew[i].instruction = mapInstruction(cases[i].instruction, instrCallback, exprCallback, &modified);
             casesNew[i].expressions.resize(cases[i].expressions.size());
-            for (unsigned int j=0; j<cases.size(); ++j) {
+            for (unsigned int j=0; j<cases[i].expressions.size(); ++j) {
                 casesNew[i].expressions[j].expr1 = AbstractExpression::mapExpression(cases[i].expressions[j].expr1, exprCallback, &modified);
                 casesNew[i].expressions[j].expr2 = AbstractExpression::mapExpression(cases[i].expressions[j].expr2, exprCallback, &modified);
             }
         }
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new CaseInstruction(sourcePosition, conditionNew, casesNew, otherInstructionNew));
+        return AstArena::create<CaseInstruction>(sourcePosition, conditionNew, casesNew, otherInstructionNew);
     }
 };
 
@@ -451,7 +444,7 @@ public:
     const Type type;
     const AbstractExpressionP condition; //might be nullptr if type is RepeatEndless
     const AbstractInstructionP instruction;
-    explicit LoopConditionInstruction(const SourcePosition& sourcePosition, Type type, AbstractExpressionP condition, AbstractInstructionP instruction):AbstractInstruction(sourcePosition),type(type),condition(condition),instruction(instruction) {}
+    explicit LoopConditionInstruction(const SourcePosition& sourcePosition, Type type, AbstractExpressionP condition, AbstractInstructionP instruction):AbstractInstruction(LoopConditionNode, sourcePosition),type(type),condition(condition),instruction(instruction) {}
     virtual ~LoopConditionInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext& parentLoopContext) const {
         auto nextLabel = byteCodeWriter.reserveLabel();
@@ -496,21 +489,20 @@ public:
         }
         byteCodeWriter.placeLabelHere(quitLabel);
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
+    template<typename F> void iterateChildExpressions(const F& callback) const {
         AbstractExpression::iterateExpression(condition, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>& callback) const {
+    template<typename F> void iterateChildInstructions(const F& callback) const {
         iterateInstruction(instruction, callback);
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>& instrCallback, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI& instrCallback, const FE& exprCallback) const {
         bool modified = false;
 
         auto instructionNew = mapInstruction(instruction, instrCallback, exprCallback, &modified);
         auto conditionNew = AbstractExpression::mapExpression(condition, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new LoopConditionInstruction(sourcePosition, type, conditionNew, instructionNew));
+        return AstArena::create<LoopConditionInstruction>(sourcePosition, type, conditionNew, instructionNew);
     }
 };
 
@@ -521,7 +513,7 @@ public:
     const AbstractExpressionP to;
     const AbstractExpressionP step; //might be nullptr
     const AbstractInstructionP instruction;
-    explicit LoopVarInstruction(const SourcePosition& sourcePosition, AbstractSpinVariableP variable, AbstractExpressionP from, AbstractExpressionP to, AbstractExpressionP step, AbstractInstructionP instruction):AbstractInstruction(sourcePosition),variable(variable),from(from),to(to),step(step),instruction(instruction) {}
+    explicit LoopVarInstruction(const SourcePosition& sourcePosition, AbstractSpinVariableP variable, AbstractExpressionP from, AbstractExpressionP to, AbstractExpressionP step, AbstractInstructionP instruction):AbstractInstruction(LoopVarNode, sourcePosition),variable(variable),from(from),to(to),step(step),instruction(instruction) {}
     virtual ~LoopVarInstruction() {}
     virtual void generate(SpinByteCodeWriter &byteCodeWriter, const InstructionLoopContext& parentLoopContext) const {
         auto nextLabel = byteCodeWriter.reserveLabel();
@@ -542,21 +534,20 @@ public:
         byteCodeWriter.appendRelativeAddress(reverseLabel); // compile reverse address
         byteCodeWriter.placeLabelHere(quitLabel); // set 'quit'/forward address
     }
-    virtual void iterateChildExpressions(const std::function<void(AbstractExpressionP)>& callback) const {
-        variable->iterateChildExpressions(callback);
+    template<typename F> void iterateChildExpressions(const F& callback) const {
+        AbstractSpinVariable::iterateVariable(variable, callback);
         AbstractExpression::iterateExpression(from, callback);
         AbstractExpression::iterateExpression(to, callback);
         AbstractExpression::iterateExpression(step, callback);
     }
-protected:
-    virtual void iterateChildInstructions(const std::function<void(AbstractInstructionP)>& callback) const {
+    template<typename F> void iterateChildInstructions(const F& callback) const {
         iterateInstruction(instruction, callback);
     }
-    virtual AbstractInstructionP mapChildren(const std::function<AbstractInstructionP(AbstractInstructionP)>& instrCallback, const std::function<AbstractExpressionP(AbstractExpressionP)>& exprCallback) {
+    template<typename FI, typename FE> AbstractInstructionP mapChildren(const FI& instrCallback, const FE& exprCallback) const {
         bool modified = false;
 
         auto instructionNew = mapInstruction(instruction, instrCallback, exprCallback, &modified);
-        auto variableNew = variable->mapChildExpressions(exprCallback);
+        auto variableNew = AbstractSpinVariable::mapVariable(variable, exprCallback);
         if (variableNew)
             modified = true;
         else
@@ -566,10 +557,69 @@ protected:
         auto stepNew = AbstractExpression::mapExpression(step, exprCallback, &modified);
         if (!modified)
             return AbstractInstructionP(); //nullptr means no change
-        return AbstractInstructionP(new LoopVarInstruction(sourcePosition, variableNew, fromNew, toNew, stepNew, instructionNew));
+        return AstArena::create<LoopVarInstruction>(sourcePosition, variableNew, fromNew, toNew, stepNew, instructionNew);
     }
 };
 
+namespace AstVisitorDetail {
+    template<typename F> struct ChildInstructionIterator {
+        const F& callback;
+        explicit ChildInstructionIterator(const F& callback):callback(callback) {}
+        template<typename T> void operator()(const T& node) const {
+            node.iterateChildInstructions(callback);
+        }
+    };
+    template<typename FI, typename FE> struct ChildInstructionMapper {
+        const FI& instrCallback;
+        const FE& exprCallback;
+        ChildInstructionMapper(const FI& instrCallback, const FE& exprCallback):instrCallback(instrCallback),exprCallback(exprCallback) {}
+        template<typename T> AbstractInstructionP operator()(const T& node) const {
+            return node.mapChildren(instrCallback, exprCallback);
+        }
+    };
+}
+
+template<typename R, typename V> inline R AbstractInstruction::visit(const AbstractInstruction& instruction, V& visitor) {
+    switch(instruction.kind) {
+        case ExpressionNode: return visitor(static_cast<const ExpressionInstruction&>(instruction));
+        case CogInitSpinNode: return visitor(static_cast<const CogInitSpinInstruction&>(instruction));
+        case CogInitAsmNode: return visitor(static_cast<const CogInitAsmInstruction&>(instruction));
+        case AbortOrReturnNode: return visitor(static_cast<const AbortOrReturnInstruction&>(instruction));
+        case NextOrQuitNode: return visitor(static_cast<const NextOrQuitInstruction&>(instruction));
+        case CallBuiltInNode: return visitor(static_cast<const CallBuiltInInstruction&>(instruction));
+        case BlockNode: return visitor(static_cast<const BlockInstruction&>(instruction));
+        case IfNode: return visitor(static_cast<const IfInstruction&>(instruction));
+        case CaseNode: return visitor(static_cast<const CaseInstruction&>(instruction));
+        case LoopConditionNode: return visitor(static_cast<const LoopConditionInstruction&>(instruction));
+        case LoopVarNode: break;
+    }
+    return visitor(static_cast<const LoopVarInstruction&>(instruction));
+}
+
+template<typename F> inline void AbstractInstruction::iterateInstructionExpressions(const AbstractInstructionP& instruction, const F& callback) {
+    const AstVisitorDetail::ChildExpressionIterator<F> iterator(callback);
+    visit<void>(*instruction, iterator);
+}
+
+template<typename F> inline void AbstractInstruction::iterateInstruction(const AbstractInstructionP& instruction, const F& callback) {
+    if (!instruction)
+        return;
+    callback(instruction);
+    const AstVisitorDetail::ChildInstructionIterator<F> iterator(callback);
+    visit<void>(*instruction, iterator);
+}
+
+template<typename FI, typename FE> inline AbstractInstructionP AbstractInstruction::mapInstruction(const AbstractInstructionP& instruction, const FI& instrCallback, const FE& exprCallback, bool *modifiedMarker) {
+    if (!instruction)
+        return AbstractInstructionP();
+    const AstVisitorDetail::ChildInstructionMapper<FI,FE> mapper(instrCallback, exprCallback);
+    auto inner = visit<AbstractInstructionP>(*instruction, mapper); //returns nullptr iff no change
+    auto res = instrCallback(inner ? inner : instruction);
+    if (res != instruction && modifiedMarker)
+        *modifiedMarker = true;
+    return res;
+}
+
 #endif //SPINCOMPILER_INSTRUCTION_H
 
 ///////////////////////////////////////////////////////////////////////////////////////////
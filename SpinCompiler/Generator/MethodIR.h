@@ -0,0 +1,164 @@
+//////////////////////////////////////////////////////////////
+//                                                          //
+// Propeller Spin/PASM Compiler                             //
+// (c)2012-2016 Parallax Inc. DBA Parallax Semiconductor.   //
+// Adapted from Chip Gracey's x86 asm code by Roy Eltham    //
+// Rewritten to modern C++ by Thilo Ackermann               //
+// See end of file for terms of use.                        //
+//                                                          //
+////////////////////////////////////////////////////////////// 
+
+#ifndef SPINCOMPILER_METHODIR_H
+#define SPINCOMPILER_METHODIR_H
+
+#include "SpinCompiler/Generator/SpinByteCodeWriter.h"
+#include <vector>
+#include <map>
+
+/*
+    Mid-level representation of a single method, built from the intermediate byte code the
+    AST writes into SpinByteCodeWriter and lowered back into a SpinByteCodeWriter.
+
+    Blocks start at labels and end after relative jumps. Control flow through addresses pushed
+    on the stack (case and lookup) is approximated by edges from every block between the push
+    and the label. Return and abort do not end a block, so the graph is a superset of the real one.
+ */
+class SpinMethodIR {
+public:
+    struct Instruction {
+        Instruction(SpinFunctionByteCodeEntry::Type type, int value, int id, AbstractConstantExpressionP expression, int line):type(type),value(value),id(id),expression(expression),line(line) {}
+        SpinFunctionByteCodeEntry::Type type;
+        int value; //byte code for StaticByte
+        int id;
+        AbstractConstantExpressionP expression; //only for PushExprConstant
+        int line; //source line from the source map, 0 if none was recorded
+    };
+    struct Block {
+        std::vector<Instruction> instructions;
+        std::vector<int> successors;
+        std::vector<int> predecessors;
+    };
+    std::vector<Block> blocks;
+
+    explicit SpinMethodIR(const SpinFunctionByteCode& code) {
+        std::vector<Instruction> instructions;
+        instructions.reserve(code.size());
+        unsigned int staticIdx = 0;
+        unsigned int operandIdx = 0;
+        unsigned int expressionIdx = 0;
+        unsigned int sourceMapIdx = 0;
+        int line = 0;
+        for (unsigned int i=0; i<code.size(); ++i) {
+            while (sourceMapIdx < code.sourceMap.size() && code.sourceMap[sourceMapIdx].entry == i)
+                line = code.sourceMap[sourceMapIdx++].line;
+            const auto type = SpinFunctionByteCodeEntry::Type(code.types[i]);
+            if (type == SpinFunctionByteCodeEntry::StaticByte) {
+                instructions.push_back(Instruction(type, code.staticBytes[staticIdx++], 0, AbstractConstantExpressionP(), line));
+                continue;
+            }
+            const auto& operand = code.operands[operandIdx++];
+            instructions.push_back(Instruction(type, operand.value, operand.id, type == SpinFunctionByteCodeEntry::PushExprConstant ? code.expressions[expressionIdx++] : AbstractConstantExpressionP(), line));
+        }
+        splitIntoBlocks(instructions);
+    }
+
+    //re-split blocks and rebuild control flow after instructions were changed
+    void rebuild() {
+        std::vector<Instruction> instructions;
+        for (const auto& b:blocks)
+            instructions.insert(instructions.end(), b.instructions.begin(), b.instructions.end());
+        splitIntoBlocks(instructions);
+    }
+
+    void lower(SpinByteCodeWriter& byteCodeWriter) const {
+        for (const auto& b:blocks)
+            for (const auto& i:b.instructions)
+                byteCodeWriter.appendIntermediateEntry(i.type, i.value, i.id, i.expression, i.line);
+    }
+
+private:
+    static bool startsBlock(const std::vector<Instruction>& instructions, unsigned int i) {
+        if (instructions[i].type == SpinFunctionByteCodeEntry::PlaceLabel)
+            return instructions[i-1].type != SpinFunctionByteCodeEntry::PlaceLabel; //consecutive labels share a block
+        return instructions[i-1].type == SpinFunctionByteCodeEntry::RelativeAddressToLabel;
+    }
+
+    void splitIntoBlocks(const std::vector<Instruction>& instructions) {
+        blocks.clear();
+        blocks.push_back(Block());
+        for (unsigned int i=0; i<instructions.size(); ++i) {
+            if (i>0 && startsBlock(instructions, i))
+                blocks.push_back(Block());
+            blocks.back().instructions.push_back(instructions[i]);
+        }
+        buildControlFlow();
+    }
+
+    void addEdge(int from, int to) {
+        auto& succ = blocks[from].successors;
+        for (int s:succ)
+            if (s == to)
+                return;
+        succ.push_back(to);
+        blocks[to].predecessors.push_back(from);
+    }
+
+    void buildControlFlow() {
+        std::map<int,int> blockOfLabel;
+        for (unsigned int b=0; b<blocks.size(); ++b)
+            for (const auto& i:blocks[b].instructions)
+                if (i.type == SpinFunctionByteCodeEntry::PlaceLabel)
+                    blockOfLabel[i.value] = b;
+        for (int b=0; b<int(blocks.size()); ++b) {
+            const auto& instructions = blocks[b].instructions;
+            bool fallsThrough = true;
+            if (!instructions.empty() && instructions.back().type == SpinFunctionByteCodeEntry::RelativeAddressToLabel) {
+                auto target = blockOfLabel.find(instructions.back().value);
+                if (target != blockOfLabel.end())
+                    addEdge(b, target->second);
+                //the jump opcode is always written right before the address
+                if (instructions.size() >= 2 && instructions[instructions.size()-2].type == SpinFunctionByteCodeEntry::StaticByte && instructions[instructions.size()-2].value == 0x04) //jmp
+                    fallsThrough = false;
+            }
+            if (fallsThrough && b+1 < int(blocks.size()))
+                addEdge(b, b+1);
+        }
+        //case and lookup jump to an address on the stack
+        for (int b=0; b<int(blocks.size()); ++b) {
+            for (const auto& i:blocks[b].instructions) {
+                if (i.type != SpinFunctionByteCodeEntry::AbsoluteAddressToLabel)
+                    continue;
+                auto target = blockOfLabel.find(i.value);
+                if (target == blockOfLabel.end())
+                    continue;
+                const int first = target->second > b ? b : 0;
+                const int last = target->second > b ? target->second : int(blocks.size());
+                for (int from=first; from<last; ++from)
+                    addEdge(from, target->second);
+            }
+        }
+    }
+};
+
+#endif //SPINCOMPILER_METHODIR_H
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//                           TERMS OF USE: MIT License                                   //
+///////////////////////////////////////////////////////////////////////////////////////////
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this  //
+// software and associated documentation files (the "Software"), to deal in the Software //
+// without restriction, including without limitation the rights to use, copy, modify,    //
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to    //
+// permit persons to whom the Software is furnished to do so, subject to the following   //
+// conditions:                                                                           //
+//                                                                                       //
+// The above copyright notice and this permission notice shall be included in all copies //
+// or substantial portions of the Software.                                              //
+//                                                                                       //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,   //
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A         //
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT    //
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION     //
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE        //
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                                //
+///////////////////////////////////////////////////////////////////////////////////////////
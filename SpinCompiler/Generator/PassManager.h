@@ -0,0 +1,386 @@
+//////////////////////////////////////////////////////////////
+//                                                          //
+// Propeller Spin/PASM Compiler                             //
+// (c)2012-2016 Parallax Inc. DBA Parallax Semiconductor.   //
+// Adapted from Chip Gracey's x86 asm code by Roy Eltham    //
+// Rewritten to modern C++ by Thilo Ackermann               //
+// See end of file for terms of use.                        //
+//                                                          //
+////////////////////////////////////////////////////////////// 
+
+#ifndef SPINCOMPILER_PASSMANAGER_H
+#define SPINCOMPILER_PASSMANAGER_H
+
+#include "SpinCompiler/Generator/MethodIR.h"
+#include "SpinCompiler/Types/CompilerSettings.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct PassStatistics {
+    PassStatistics(const std::string& name, const std::string& unit):name(name),unit(unit),runs(0),changedMethods(0),sizeDelta(0),microseconds(0) {}
+    std::string name;
+    std::string unit; //what sizeDelta counts, AST nodes or intermediate byte code entries
+    int runs;
+    int changedMethods;
+    int sizeDelta;
+    long long microseconds;
+};
+
+/*
+    Runs the optimization passes enabled by CompilerSettings::optimization on every method.
+    AST passes rewrite the function body before byte code is generated, byte code passes work on
+    a SpinMethodIR of the generated intermediate code. At -O0 no pass is registered, so the output
+    stays byte-exact to the Propeller Tool.
+ */
+class PassManager {
+public:
+    enum Level { O1=1, O2=2, Os=4 }; //bitmask of levels a pass runs at, no size specific pass exists yet so Os equals O1
+    typedef AbstractInstructionP (*AstPass)(const AbstractInstructionP& functionBody); //returns functionBody if unchanged
+    typedef bool (*ByteCodePass)(SpinMethodIR& ir); //returns true if ir was changed
+
+    explicit PassManager(CompilerSettings::Optimization optimization):m_level(levelOf(optimization)) {
+        registerAstPass("prune-constant-branches", O1|O2|Os, &pruneConstantBranches);
+        registerAstPass("fold-constants", O1|O2|Os, &foldConstants);
+        registerAstPass("strength-reduction", O2, &strengthReduction);
+        registerByteCodePass("remove-unreachable-code", O1|O2|Os, &removeUnreachableBlocks);
+        registerByteCodePass("remove-jumps-to-next", O1|O2|Os, &removeJumpsToNextBlock);
+    }
+
+    //passes not enabled at the current level are ignored
+    void registerAstPass(const std::string& name, int levels, AstPass pass) {
+        if (!(levels & m_level))
+            return;
+        m_astPasses.push_back(AstPassEntry(m_statistics.size(), pass));
+        m_statistics.push_back(PassStatistics(name, "nodes"));
+    }
+    void registerByteCodePass(const std::string& name, int levels, ByteCodePass pass) {
+        if (!(levels & m_level))
+            return;
+        m_byteCodePasses.push_back(ByteCodePassEntry(m_statistics.size(), pass));
+        m_statistics.push_back(PassStatistics(name, "entries"));
+    }
+
+    AbstractInstructionP runAstPasses(const AbstractInstructionP& functionBody) {
+        AbstractInstructionP result = functionBody;
+        if (m_astPasses.empty())
+            return result;
+        int size = countNodes(result);
+        for (const auto& p:m_astPasses) {
+            auto& stats = m_statistics[p.statisticsIndex];
+            const auto start = std::chrono::steady_clock::now();
+            auto passResult = p.pass(result);
+            stats.microseconds += elapsedMicroseconds(start);
+            stats.runs++;
+            if (passResult == result)
+                continue;
+            result = passResult;
+            const int newSize = countNodes(result);
+            stats.changedMethods++;
+            stats.sizeDelta += newSize-size;
+            size = newSize;
+        }
+        return result;
+    }
+
+    //replaces the intermediate code written through byteCodeWriter with the optimized code
+    void runByteCodePasses(SpinFunctionByteCode& code, SpinByteCodeWriter& byteCodeWriter) {
+        if (m_byteCodePasses.empty())
+            return;
+        auto start = std::chrono::steady_clock::now();
+        SpinMethodIR ir(code);
+        long long buildTime = elapsedMicroseconds(start); //accounted to the first pass
+        int size = code.size();
+        bool changed = false;
+        for (const auto& p:m_byteCodePasses) {
+            auto& stats = m_statistics[p.statisticsIndex];
+            start = std::chrono::steady_clock::now();
+            const bool passChanged = p.pass(ir);
+            if (passChanged)
+                ir.rebuild();
+            stats.microseconds += elapsedMicroseconds(start)+buildTime;
+            buildTime = 0;
+            stats.runs++;
+            if (!passChanged)
+                continue;
+            changed = true;
+            const int newSize = countEntries(ir);
+            stats.changedMethods++;
+            stats.sizeDelta += newSize-size;
+            size = newSize;
+        }
+        if (!changed)
+            return;
+        code = SpinFunctionByteCode(code.recordSourceMap);
+        ir.lower(byteCodeWriter);
+    }
+
+    const std::vector<PassStatistics>& statistics() const {
+        return m_statistics;
+    }
+
+private:
+    struct AstPassEntry {
+        AstPassEntry(int statisticsIndex, AstPass pass):statisticsIndex(statisticsIndex),pass(pass) {}
+        int statisticsIndex;
+        AstPass pass;
+    };
+    struct ByteCodePassEntry {
+        ByteCodePassEntry(int statisticsIndex, ByteCodePass pass):statisticsIndex(statisticsIndex),pass(pass) {}
+        int statisticsIndex;
+        ByteCodePass pass;
+    };
+    const int m_level;
+    std::vector<AstPassEntry> m_astPasses;
+    std::vector<ByteCodePassEntry> m_byteCodePasses;
+    std::vector<PassStatistics> m_statistics;
+
+    static int levelOf(CompilerSettings::Optimization optimization) {
+        switch(optimization) {
+            case CompilerSettings::Optimization::O0: return 0;
+            case CompilerSettings::Optimization::O1: return O1;
+            case CompilerSettings::Optimization::O2: return O2;
+            case CompilerSettings::Optimization::Os: return Os;
+        }
+        return 0;
+    }
+    static long long elapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+    }
+    static int countNodes(const AbstractInstructionP& functionBody) {
+        int count = 0;
+        auto countExpression = [&count](const AbstractExpressionP&) { ++count; };
+        AbstractInstruction::iterateInstruction(functionBody, [&count,&countExpression](const AbstractInstructionP& instruction) {
+            ++count;
+            AbstractInstruction::iterateInstructionExpressions(instruction, countExpression);
+        });
+        return count;
+    }
+    static int countEntries(const SpinMethodIR& ir) {
+        int count = 0;
+        for (const auto& b:ir.blocks)
+            count += b.instructions.size();
+        return count;
+    }
+
+    static AbstractInstructionP keepInstruction(const AbstractInstructionP& instruction) {
+        return instruction;
+    }
+    static AbstractExpressionP keepExpression(const AbstractExpressionP& expression) {
+        return expression;
+    }
+    static bool constantValueOf(const AbstractExpressionP& expression, int& value) {
+        if (!expression || expression->kind != AbstractExpression::PushConstantNode)
+            return false;
+        return static_cast<const PushConstantExpression&>(*expression).constant->isConstant(&value);
+    }
+    static AbstractInstructionP emptyBlock(const SourcePosition& sourcePosition) {
+        return AstArena::create<BlockInstruction>(sourcePosition, std::vector<AbstractInstructionP>());
+    }
+
+    //if/elseif branches and while/until loops with constant conditions
+    static AbstractInstructionP pruneConstantBranches(const AbstractInstructionP& functionBody) {
+        auto pruneInstruction = [](const AbstractInstructionP& instruction) -> AbstractInstructionP {
+            if (instruction->kind == AbstractInstruction::IfNode) {
+                const auto& ifInstr = static_cast<const IfInstruction&>(*instruction);
+                std::vector<IfInstruction::Branch> branches;
+                AbstractInstructionP elseBranch = ifInstr.elseBranch;
+                bool modified = false;
+                for (const auto& b:ifInstr.branches) {
+                    int value = 0;
+                    if (!constantValueOf(b.condition, value)) {
+                        branches.push_back(b);
+                        continue;
+                    }
+                    modified = true;
+                    if ((value != 0) != b.conditionInverted) { //always taken, later branches are dead
+                        elseBranch = b.instruction;
+                        break;
+                    }
+                }
+                if (!modified)
+                    return instruction;
+                if (!branches.empty())
+                    return AstArena::create<IfInstruction>(instruction->sourcePosition, branches, elseBranch);
+                return elseBranch ? elseBranch : emptyBlock(instruction->sourcePosition);
+            }
+            if (instruction->kind == AbstractInstruction::LoopConditionNode) {
+                const auto& loop = static_cast<const LoopConditionInstruction&>(*instruction);
+                int value = 0;
+                if (loop.type == LoopConditionInstruction::RepeatCount || loop.type == LoopConditionInstruction::RepeatEndless || !constantValueOf(loop.condition, value))
+                    return instruction;
+                const bool isWhile = loop.type == LoopConditionInstruction::PreWhile || loop.type == LoopConditionInstruction::PostWhile;
+                if ((value != 0) == isWhile) //never exits through the condition
+                    return AstArena::create<LoopConditionInstruction>(instruction->sourcePosition, LoopConditionInstruction::RepeatEndless, AbstractExpressionP(), loop.instruction);
+                if (loop.type == LoopConditionInstruction::PreWhile || loop.type == LoopConditionInstruction::PreUntil) //body never runs
+                    return emptyBlock(instruction->sourcePosition);
+            }
+            return instruction;
+        };
+        return AbstractInstruction::mapInstruction(functionBody, pruneInstruction, &keepExpression);
+    }
+
+    //only operators whose interpreter result equals 32 bit integer arithmetic
+    static bool foldBinary(OperatorType::Type operation, int left, int right, int& result) {
+        const unsigned int uLeft = left;
+        const unsigned int uRight = right;
+        switch(operation) {
+            case OperatorType::OpAdd: result = int(uLeft+uRight); return true;
+            case OperatorType::OpSub: result = int(uLeft-uRight); return true;
+            case OperatorType::OpMul: result = int(uLeft*uRight); return true;
+            case OperatorType::OpAnd: result = left & right; return true;
+            case OperatorType::OpOr: result = left | right; return true;
+            case OperatorType::OpXor: result = left ^ right; return true;
+            case OperatorType::OpShl:
+                if (uRight >= 32)
+                    return false;
+                result = int(uLeft << uRight);
+                return true;
+            case OperatorType::OpShr:
+                if (uRight >= 32)
+                    return false;
+                result = int(uLeft >> uRight);
+                return true;
+            case OperatorType::OpCmpB:
+            case OperatorType::OpCmpA:
+            case OperatorType::OpCmpNe:
+            case OperatorType::OpCmpE:
+            case OperatorType::OpCmpBe:
+            case OperatorType::OpCmpAe:
+            case OperatorType::OpLogAnd:
+            case OperatorType::OpLogOr:
+                result = BinaryConstantExpression::performOpBinary(left, right, operation, false);
+                return true;
+            default:
+                return false;
+        }
+    }
+    static bool foldUnary(OperatorType::Type operation, int value, int& result) {
+        switch(operation) {
+            case OperatorType::OpNeg: result = int(0u-static_cast<unsigned int>(value)); return true;
+            case OperatorType::OpNot: result = ~value; return true;
+            case OperatorType::OpLogNot: result = value == 0 ? -1 : 0; return true;
+            default:
+                return false;
+        }
+    }
+
+    static AbstractInstructionP foldConstants(const AbstractInstructionP& functionBody) {
+        auto foldExpression = [](const AbstractExpressionP& expression) -> AbstractExpressionP {
+            int left = 0;
+            int right = 0;
+            int result = 0;
+            if (expression->kind == AbstractExpression::BinaryNode) {
+                const auto& binary = static_cast<const BinaryExpression&>(*expression);
+                if (constantValueOf(binary.left, left) && constantValueOf(binary.right, right) && foldBinary(binary.operation, left, right, result))
+                    return AstArena::create<PushConstantExpression>(expression->sourcePosition, result, ConstantEncoding::AutoDetect);
+            }
+            else if (expression->kind == AbstractExpression::UnaryNode) {
+                const auto& unary = static_cast<const UnaryExpression&>(*expression);
+                if (constantValueOf(unary.expression, left) && foldUnary(unary.operation, left, result))
+                    return AstArena::create<PushConstantExpression>(expression->sourcePosition, result, ConstantEncoding::AutoDetect);
+            }
+            return expression;
+        };
+        return AbstractInstruction::mapInstruction(functionBody, &keepInstruction, foldExpression);
+    }
+
+    //multiplication by a power of two becomes a shift, which the interpreter executes much faster
+    static AbstractInstructionP strengthReduction(const AbstractInstructionP& functionBody) {
+        auto reduceExpression = [](const AbstractExpressionP& expression) -> AbstractExpressionP {
+            if (expression->kind != AbstractExpression::BinaryNode)
+                return expression;
+            const auto& binary = static_cast<const BinaryExpression&>(*expression);
+            if (binary.operation != OperatorType::OpMul)
+                return expression;
+            int value = 0;
+            AbstractExpressionP other;
+            if (constantValueOf(binary.right, value))
+                other = binary.left;
+            else if (constantValueOf(binary.left, value)) //constants have no side effects, so operands may be swapped
+                other = binary.right;
+            else
+                return expression;
+            const unsigned int factor = value;
+            if (factor < 2 || (factor & (factor-1)) != 0)
+                return expression;
+            int shift = 0;
+            while ((1u << shift) != factor)
+                ++shift;
+            auto shiftExpression = AstArena::create<PushConstantExpression>(expression->sourcePosition, shift, ConstantEncoding::AutoDetect);
+            return AstArena::create<BinaryExpression>(expression->sourcePosition, other, shiftExpression, OperatorType::OpShl);
+        };
+        return AbstractInstruction::mapInstruction(functionBody, &keepInstruction, reduceExpression);
+    }
+
+    //blocks that can not be reached from the method entry, e.g. code following an endless repeat
+    static bool removeUnreachableBlocks(SpinMethodIR& ir) {
+        std::vector<bool> reachable(ir.blocks.size(), false);
+        std::vector<int> pending(1, 0);
+        reachable[0] = true;
+        while (!pending.empty()) {
+            const int b = pending.back();
+            pending.pop_back();
+            for (int s:ir.blocks[b].successors) {
+                if (reachable[s])
+                    continue;
+                reachable[s] = true;
+                pending.push_back(s);
+            }
+        }
+        std::vector<SpinMethodIR::Block> blocks;
+        for (unsigned int b=0; b<ir.blocks.size(); ++b)
+            if (reachable[b])
+                blocks.push_back(ir.blocks[b]);
+        if (blocks.size() == ir.blocks.size())
+            return false;
+        ir.blocks.swap(blocks);
+        return true;
+    }
+
+    //jmp whose target label is placed right after it, e.g. at the end of the last if branch after pruning
+    static bool removeJumpsToNextBlock(SpinMethodIR& ir) {
+        bool changed = false;
+        for (unsigned int b=0; b+1<ir.blocks.size(); ++b) {
+            auto& instructions = ir.blocks[b].instructions;
+            const unsigned int count = instructions.size();
+            if (count < 2 || instructions[count-1].type != SpinFunctionByteCodeEntry::RelativeAddressToLabel)
+                continue;
+            if (instructions[count-2].type != SpinFunctionByteCodeEntry::StaticByte || instructions[count-2].value != 0x04) //jmp
+                continue;
+            for (const auto& i:ir.blocks[b+1].instructions) {
+                if (i.type != SpinFunctionByteCodeEntry::PlaceLabel)
+                    break;
+                if (i.value == instructions[count-1].value) {
+                    instructions.erase(instructions.end()-2, instructions.end());
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        return changed;
+    }
+};
+
+#endif //SPINCOMPILER_PASSMANAGER_H
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//                           TERMS OF USE: MIT License                                   //
+///////////////////////////////////////////////////////////////////////////////////////////
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this  //
+// software and associated documentation files (the "Software"), to deal in the Software //
+// without restriction, including without limitation the rights to use, copy, modify,    //
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to    //
+// permit persons to whom the Software is furnished to do so, subject to the following   //
+// conditions:                                                                           //
+//                                                                                       //
+// The above copyright notice and this permission notice shall be included in all copies //
+// or substantial portions of the Software.                                              //
+//                                                                                       //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,   //
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A         //
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT    //
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION     //
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE        //
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                                //
+///////////////////////////////////////////////////////////////////////////////////////////
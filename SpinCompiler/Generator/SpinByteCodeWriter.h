@@ -16,6 +16,7 @@
 #include "SpinCompiler/Types/SpinVariableInfo.h"
 #include <vector>
 #include <map>
+#include <set>
 #include <iostream> //TODO weg
 
 enum struct ConstantEncoding {
@@ -28,13 +29,6 @@ struct SpinFunctionByteCodeEntry { //TODO wo anders hin
                 CogInitNewSpinSubroutine,SubroutineOwnObject,SubroutineChildObject,
                 VariableDat,VariableVar,VariableLoc,
                 PlaceLabel,RelativeAddressToLabel,AbsoluteAddressToLabel};
-    SpinFunctionByteCodeEntry(const SourcePosition& sourcePosition, Type type, int value, int id=0, AbstractConstantExpressionP expression=AbstractConstantExpressionP()):sourcePosition(sourcePosition),type(type),value(value),id(id),expression(expression) {}
-    SourcePosition sourcePosition;
-    Type type;
-    int value; //for type==CogInitNewSpinSubroutine: parameterCount
-    int id;
-    AbstractConstantExpressionP expression;
-
 
     static int packVarInfo(int operation, int varSize, bool hasIndexExpression) { //TODO weg
         return (!hasIndexExpression ? 1 : 0) + (varSize<<8) + (operation<<16);
@@ -46,26 +40,64 @@ struct SpinFunctionByteCodeEntry { //TODO wo anders hin
     }
 };
 
+//intermediate byte code of a method as struct of arrays
+//every entry has a type, static bytes and operands of the other entries are consumed in order from their own arrays
+struct SpinFunctionByteCode {
+    struct Operand {
+        Operand(int value, int id):value(value),id(id) {}
+        int value; //for type==CogInitNewSpinSubroutine: parameterCount
+        int id;
+    };
+    struct SourceMapEntry {
+        SourceMapEntry(unsigned int entry, int line):entry(entry),line(line) {}
+        unsigned int entry; //first entry generated for line
+        int line;
+    };
+    explicit SpinFunctionByteCode(bool recordSourceMap=false):recordSourceMap(recordSourceMap) {}
+    std::vector<unsigned char> types; //SpinFunctionByteCodeEntry::Type of each entry
+    std::vector<unsigned char> staticBytes; //one per StaticByte entry
+    std::vector<Operand> operands; //one per entry of any other type
+    std::vector<AbstractConstantExpressionP> expressions; //one per PushExprConstant entry
+    bool recordSourceMap; //set if method annotations are built
+    std::vector<SourceMapEntry> sourceMap; //one entry per change of the source line, empty unless recordSourceMap
+
+    unsigned int size() const {
+        return types.size();
+    }
+};
+
 struct SpinStringInfo {
-    SpinStringInfo() {}
-    SpinStringInfo(const SourcePosition& sourcePosition, const std::vector<AbstractConstantExpressionP> &characters):sourcePosition(sourcePosition),characters(characters) {}
+    SpinStringInfo():stringNumber(0) {}
+    SpinStringInfo(const SourcePosition& sourcePosition, int stringNumber, const std::vector<AbstractConstantExpressionP> &characters):sourcePosition(sourcePosition),stringNumber(stringNumber),characters(characters) {}
     SourcePosition sourcePosition;
+    int stringNumber;
     std::vector<AbstractConstantExpressionP> characters;
 };
 
 class SpinByteCodeWriter {
 public:
 private:
-    std::vector<SpinFunctionByteCodeEntry> &m_code;
+    SpinFunctionByteCode &m_code;
     std::map<int, SpinStringInfo> m_stringMap;
     int m_nextLabel;
     int m_nextExtraString;
 public:
-    SpinByteCodeWriter(std::vector<SpinFunctionByteCodeEntry> &code):m_code(code),m_nextLabel(1),m_nextExtraString(1) {}
+    SpinByteCodeWriter(SpinFunctionByteCode &code):m_code(code),m_nextLabel(1),m_nextExtraString(1) {}
+    //strings still referenced by the code (optimization passes may have removed some), ordered by string number
     std::vector<SpinStringInfo> retrieveAllStrings() {
+        std::set<int> referenced;
+        unsigned int operandIdx = 0;
+        for (auto type:m_code.types) {
+            if (type == SpinFunctionByteCodeEntry::StaticByte)
+                continue;
+            if (type == SpinFunctionByteCodeEntry::StringReference)
+                referenced.insert(m_code.operands[operandIdx].value);
+            ++operandIdx;
+        }
         std::vector<SpinStringInfo> result;
         for (auto it:m_stringMap)
-            result.push_back(it.second);
+            if (referenced.count(it.first))
+                result.push_back(it.second);
         return result;
     }
 
@@ -74,15 +106,15 @@ public:
     }
 
     void placeLabelHere(SpinByteCodeLabel label) {
-        m_code.push_back(SpinFunctionByteCodeEntry(SourcePosition(), SpinFunctionByteCodeEntry::PlaceLabel,label.value()));
+        appendEntry(SpinFunctionByteCodeEntry::PlaceLabel, label.value());
     }
 
     void appendAbsoluteAddress(SpinByteCodeLabel label) {
-        m_code.push_back(SpinFunctionByteCodeEntry(SourcePosition(), SpinFunctionByteCodeEntry::AbsoluteAddressToLabel,label.value()));
+        appendEntry(SpinFunctionByteCodeEntry::AbsoluteAddressToLabel, label.value());
     }
 
     void appendRelativeAddress(SpinByteCodeLabel label) {
-        m_code.push_back(SpinFunctionByteCodeEntry(SourcePosition(), SpinFunctionByteCodeEntry::RelativeAddressToLabel,label.value()));
+        appendEntry(SpinFunctionByteCodeEntry::RelativeAddressToLabel, label.value());
     }
     void appendPopStack() {
         //TODO
@@ -91,38 +123,66 @@ public:
         appendStaticByte(0x14); // pop
     }
     void appendStaticByte(int byteCode) {
-        m_code.push_back(SpinFunctionByteCodeEntry(SourcePosition(), SpinFunctionByteCodeEntry::StaticByte, byteCode));
+        m_code.types.push_back(SpinFunctionByteCodeEntry::StaticByte);
+        m_code.staticBytes.push_back(byteCode);
     }
     void appendStaticPushConstant(const SourcePosition& sourcePosition, int constantValue, ConstantEncoding encoding) {
-        m_code.push_back(SpinFunctionByteCodeEntry(sourcePosition, SpinFunctionByteCodeEntry::PushIntConstant, constantValue, int(encoding)));
+        mapSourceLine(sourcePosition.line);
+        appendEntry(SpinFunctionByteCodeEntry::PushIntConstant, constantValue, int(encoding));
     }
     void appendStaticPushConstant(const SourcePosition& sourcePosition, AbstractConstantExpressionP expression, ConstantEncoding encoding) {
-        m_code.push_back(SpinFunctionByteCodeEntry(sourcePosition, SpinFunctionByteCodeEntry::PushExprConstant, 0, int(encoding), expression));
+        mapSourceLine(sourcePosition.line);
+        appendEntry(SpinFunctionByteCodeEntry::PushExprConstant, 0, int(encoding));
+        m_code.expressions.push_back(expression);
     }
 
     void appendStringReference(const SourcePosition& sourcePosition, int stringNumber, const std::vector<AbstractConstantExpressionP>& stringData) {
         if (stringNumber<0)
             stringNumber = -m_nextExtraString++; //see PushStringExpression for description of this mechanism
-        m_stringMap[stringNumber] = SpinStringInfo(sourcePosition, stringData);
-        m_code.push_back(SpinFunctionByteCodeEntry(sourcePosition, SpinFunctionByteCodeEntry::StringReference, stringNumber));
+        m_stringMap[stringNumber] = SpinStringInfo(sourcePosition, stringNumber, stringData);
+        mapSourceLine(sourcePosition.line);
+        appendEntry(SpinFunctionByteCodeEntry::StringReference, stringNumber);
     }
 
     void appendCogInitNewSpinSubroutine(const SourcePosition& sourcePosition, int parameterCount, MethodId methodId) {
-        m_code.push_back(SpinFunctionByteCodeEntry(sourcePosition, SpinFunctionByteCodeEntry::CogInitNewSpinSubroutine,parameterCount,methodId.value()));
+        mapSourceLine(sourcePosition.line);
+        appendEntry(SpinFunctionByteCodeEntry::CogInitNewSpinSubroutine, parameterCount, methodId.value());
     }
 
     void appendSubroutineOfOwnObject(const SourcePosition& sourcePosition, MethodId methodId) {
-        m_code.push_back(SpinFunctionByteCodeEntry(sourcePosition, SpinFunctionByteCodeEntry::SubroutineOwnObject,0,methodId.value()));
+        mapSourceLine(sourcePosition.line);
+        appendEntry(SpinFunctionByteCodeEntry::SubroutineOwnObject, 0, methodId.value());
     }
 
     void appendSubroutineOfChildObject(const SourcePosition& sourcePosition, ObjectInstanceId objectIndexId, MethodId methodId) {
-        m_code.push_back(SpinFunctionByteCodeEntry(sourcePosition, SpinFunctionByteCodeEntry::SubroutineChildObject,objectIndexId.value(),methodId.value()));
+        mapSourceLine(sourcePosition.line);
+        appendEntry(SpinFunctionByteCodeEntry::SubroutineChildObject, objectIndexId.value(), methodId.value());
     }
 
     void appendVariableReference(const SourcePosition& sourcePosition, SpinFunctionByteCodeEntry::Type type, int operation, int varSize, bool hasIndexExpression, int symbolId) {
-        m_code.push_back(SpinFunctionByteCodeEntry(sourcePosition, type,
-                                                   SpinFunctionByteCodeEntry::packVarInfo(operation,varSize,hasIndexExpression),
-                                                   symbolId));
+        mapSourceLine(sourcePosition.line);
+        appendEntry(type, SpinFunctionByteCodeEntry::packVarInfo(operation,varSize,hasIndexExpression), symbolId);
+    }
+    //re-emits an entry of intermediate code, used when lowering SpinMethodIR
+    void appendIntermediateEntry(SpinFunctionByteCodeEntry::Type type, int value, int id, AbstractConstantExpressionP expression, int sourceLine) {
+        mapSourceLine(sourceLine);
+        if (type == SpinFunctionByteCodeEntry::StaticByte) {
+            appendStaticByte(value);
+            return;
+        }
+        appendEntry(type, value, id);
+        if (type == SpinFunctionByteCodeEntry::PushExprConstant)
+            m_code.expressions.push_back(expression);
+    }
+private:
+    void mapSourceLine(int line) {
+        if (!m_code.recordSourceMap || line <= 0 || (!m_code.sourceMap.empty() && m_code.sourceMap.back().line == line))
+            return;
+        m_code.sourceMap.push_back(SpinFunctionByteCode::SourceMapEntry(m_code.types.size(), line));
+    }
+    void appendEntry(SpinFunctionByteCodeEntry::Type type, int value, int id=0) {
+        m_code.types.push_back(type);
+        m_code.operands.push_back(SpinFunctionByteCode::Operand(value, id));
     }
 };
 
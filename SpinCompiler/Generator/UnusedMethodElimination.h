@@ -12,14 +12,17 @@
 #define SPINCOMPILER_UNUSEDMETHODELIMINATION_H
 
 #include "SpinCompiler/Parser/ParsedObject.h"
+#include "SpinCompiler/Parser/AbstractParser.h"
 #include "SpinCompiler/Generator/Instruction.h"
 
 class UnusedMethodElimination {
 private:
     std::map<ParsedObject*,std::vector<bool> > m_usedMethods;
+    AbstractParser *m_parser;
 public:
-    static void eliminateUnused(ParsedObjectP rootObj, bool includeAllCogNewMethods) {
-        UnusedMethodElimination ume;
+    //method bodies are parsed by the parser when they are reached first
+    static void eliminateUnused(ParsedObjectP rootObj, bool includeAllCogNewMethods, AbstractParser *parser) {
+        UnusedMethodElimination ume(parser);
         if (rootObj->methods.empty())
             return;
         ume.markMethodUsedAndFollow(rootObj.get(),rootObj->methods[0]->methodId);
@@ -29,7 +32,7 @@ public:
         ume.removeUnusedMethods();
     }
 private:
-    UnusedMethodElimination() {
+    explicit UnusedMethodElimination(AbstractParser *parser):m_parser(parser) {
     }
 
     void markAllCogNewMethods() {
@@ -40,6 +43,9 @@ private:
                 usedObjects.push_back(it->first);
             for (auto obj:usedObjects) {
                 for (auto method:obj->methods) {
+                    if (!method->functionBody && !method->mayStartCog)
+                        continue;
+                    m_parser->parseMethodBody(obj, method);
                     inspectInstructions(obj, method->functionBody, true);
                 }
             }
@@ -63,30 +69,32 @@ private:
             for (unsigned int i=0; i<obj->methods.size(); ++i)
                 if (it->second[i])
                     usedMethods.push_back(obj->methods[i]);
-            obj->methods = usedMethods;
+            obj->setMethods(usedMethods);
         }
     }
     void markMethodUsedAndFollow(ParsedObject* obj, MethodId methodId) {
         const int methodIdx = obj->methodIndexById(methodId);
         if (markMethodUsed(obj, methodIdx))
             return; //was already marked used, do not follow anymore
+        m_parser->parseMethodBody(obj, obj->methods[methodIdx]);
         inspectInstructions(obj, obj->methods[methodIdx]->functionBody, false);
     }
 
     void inspectInstructions(ParsedObject* obj, AbstractInstructionP topInstruction, bool onlyCogInitNewRoutines) {
-        AbstractInstruction::iterateInstruction(topInstruction,[this, obj, onlyCogInitNewRoutines](AbstractInstructionP instruction) {
-            if (auto cogInit = std::dynamic_pointer_cast<CogInitSpinInstruction>(instruction))
-                markMethodUsedAndFollow(obj, cogInit->methodId);
-            instruction->iterateChildExpressions([this,obj, onlyCogInitNewRoutines](AbstractExpressionP expression) {
-                if (auto cogNew = std::dynamic_pointer_cast<CogNewSpinExpression>(expression))
-                    markMethodUsedAndFollow(obj, cogNew->methodId);
+        AbstractInstruction::iterateInstruction(topInstruction,[this, obj, onlyCogInitNewRoutines](const AbstractInstructionP& instruction) {
+            if (instruction->kind == AbstractInstruction::CogInitSpinNode)
+                markMethodUsedAndFollow(obj, static_cast<const CogInitSpinInstruction&>(*instruction).methodId);
+            AbstractInstruction::iterateInstructionExpressions(instruction, [this,obj, onlyCogInitNewRoutines](const AbstractExpressionP& expression) {
+                if (expression->kind == AbstractExpression::CogNewSpinNode)
+                    markMethodUsedAndFollow(obj, static_cast<const CogNewSpinExpression&>(*expression).methodId);
                 if (onlyCogInitNewRoutines)
                     return;
-                if (auto methodCall = std::dynamic_pointer_cast<MethodCallExpression>(expression)) {
-                    if (methodCall->objectInstanceId.valid()) //method call of child obj
-                        markMethodUsedAndFollow(obj->childObjectByObjectInstanceId(methodCall->objectInstanceId).object.get(), methodCall->methodId);
+                if (expression->kind == AbstractExpression::MethodCallNode) {
+                    auto& methodCall = static_cast<const MethodCallExpression&>(*expression);
+                    if (methodCall.objectInstanceId.valid()) //method call of child obj
+                        markMethodUsedAndFollow(obj->childObjectByObjectInstanceId(methodCall.objectInstanceId).object.get(), methodCall.methodId);
                     else //method call of own obj
-                        markMethodUsedAndFollow(obj, methodCall->methodId);
+                        markMethodUsedAndFollow(obj, methodCall.methodId);
                 }
             });
         });
@@ -15,15 +15,31 @@
 #include "SpinCompiler/Tokenizer/StringMap.h"
 #include "SpinCompiler/Tokenizer/SpinBuiltInSymbolMap.h"
 #include "SpinCompiler/Parser/ObjectHierarchy.h"
+#include <mutex>
 
 class AbstractParser {
 public:
-    explicit AbstractParser(AbstractFileHandler *fileHandler):fileHandler(fileHandler),builtInSymbols(stringMap) {}
+    explicit AbstractParser(AbstractFileHandler *fileHandler):fileHandler(fileHandler),builtInSymbols(stringMap),astArena(new AstArena()) {}
     virtual ~AbstractParser() {}
     AbstractFileHandler *fileHandler;
     StringMap stringMap;
     SpinBuiltInSymbolMap builtInSymbols;
+    AstArenaP astArena; //nodes of the syntax trees of all objects, parser threads make it their current arena
     virtual ParsedObjectP compileObject(FileDescriptorP file, const ObjectHierarchy *hierarchy, const SourcePosition& includePos)=0;
+    virtual void prefetchObject(FileDescriptorP file, const ObjectHierarchy *hierarchy, const SourcePosition& includePos)=0; //start compiling in the background, compileObject must be called later with the same arguments
+    virtual void parseMethodBody(ParsedObject* object, ParsedObject::MethodP method)=0; //parse body if it was skipped by compileObject
+
+    //objects are compiled on several threads, the file handler is not thread safe
+    FileDescriptorP findFile(const std::string& fileName, AbstractFileHandler::FileType fileType, const SourcePosition& includedInPosition) {
+        std::lock_guard<std::mutex> lock(m_fileHandlerMutex);
+        return fileHandler->findFile(fileName, fileType, FileDescriptorP(), includedInPosition);
+    }
+    void prefetchFile(const std::string& fileName, AbstractFileHandler::FileType fileType) {
+        std::lock_guard<std::mutex> lock(m_fileHandlerMutex);
+        fileHandler->prefetchFile(fileName, fileType);
+    }
+private:
+    std::mutex m_fileHandlerMutex;
 };
 
 #endif //SPINCOMPILER_ABSTRACTPARSER_H
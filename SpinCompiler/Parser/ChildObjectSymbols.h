@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////
+//                                                          //
+// Propeller Spin/PASM Compiler                             //
+// (c)2012-2016 Parallax Inc. DBA Parallax Semiconductor.   //
+// Adapted from Chip Gracey's x86 asm code by Roy Eltham    //
+// Rewritten to modern C++ by Thilo Ackermann               //
+// See end of file for terms of use.                        //
+//                                                          //
+////////////////////////////////////////////////////////////// 
+
+#ifndef SPINCOMPILER_CHILDOBJECTSYMBOLS_H
+#define SPINCOMPILER_CHILDOBJECTSYMBOLS_H
+
+#include "SpinCompiler/Tokenizer/SymbolMap.h"
+#include "SpinCompiler/Types/ConstantExpression.h"
+
+//pub methods and constants of an object as seen by its parents, built once per object and shared by all parents
+struct ObjectExports {
+    //constant known only when the object is generated, every parent binds it to the object class it gives the object
+    struct UnboundConstant {
+        UnboundConstant(SpinSymbolId symbolId, const SourcePosition& sourcePosition, int constantIndex, bool isInteger):symbolId(symbolId),sourcePosition(sourcePosition),constantIndex(constantIndex),isInteger(isInteger) {}
+        SpinSymbolId symbolId;
+        SourcePosition sourcePosition;
+        int constantIndex;
+        bool isInteger;
+    };
+    std::shared_ptr<const SymbolMap> symbols;
+    std::vector<UnboundConstant> unboundConstants;
+};
+typedef std::shared_ptr<const ObjectExports> ObjectExportsP;
+
+//con and pub symbols of the child objects, by object class
+//the symbol tables are the exports of the child objects, they are shared by all parents instead of copied
+class ChildObjectSymbols {
+public:
+    void addObjectClass(ObjectClassId objectClass, ObjectExportsP exports, bool withMethods) {
+        ObjectClass& cls = m_objectClasses[objectClass] = ObjectClass(exports->symbols, withMethods);
+        for (const auto& c:exports->unboundConstants)
+            cls.boundConstants[c.symbolId] = std::make_shared<SpinConstantSymbol>(AstArena::create<ChildObjConstantExpression>(c.sourcePosition, objectClass, c.constantIndex), c.isInteger);
+    }
+    std::shared_ptr<SpinSubSymbol> hasMethod(SpinSymbolId symbolId, ObjectClassId objectClass) const {
+        auto it = m_objectClasses.find(objectClass);
+        if (it == m_objectClasses.end() || !it->second.withMethods)
+            return std::shared_ptr<SpinSubSymbol>();
+        return it->second.exports->hasSpecificSymbol<SpinSubSymbol>(symbolId, 0);
+    }
+    std::shared_ptr<SpinConstantSymbol> hasConstant(SpinSymbolId symbolId, ObjectClassId objectClass) const {
+        auto it = m_objectClasses.find(objectClass);
+        if (it == m_objectClasses.end())
+            return std::shared_ptr<SpinConstantSymbol>();
+        auto bound = it->second.boundConstants.find(symbolId);
+        if (bound != it->second.boundConstants.end())
+            return bound->second;
+        return it->second.exports->hasSpecificSymbol<SpinConstantSymbol>(symbolId, 0);
+    }
+private:
+    struct ObjectClass {
+        ObjectClass():withMethods(false) {}
+        ObjectClass(std::shared_ptr<const SymbolMap> exports, bool withMethods):exports(exports),withMethods(withMethods) {}
+        std::shared_ptr<const SymbolMap> exports;
+        std::map<SpinSymbolId,std::shared_ptr<SpinConstantSymbol>> boundConstants; //exported constants bound to this object class
+        bool withMethods;
+    };
+    std::map<ObjectClassId,ObjectClass> m_objectClasses;
+};
+
+#endif //SPINCOMPILER_CHILDOBJECTSYMBOLS_H
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//                           TERMS OF USE: MIT License                                   //
+///////////////////////////////////////////////////////////////////////////////////////////
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this  //
+// software and associated documentation files (the "Software"), to deal in the Software //
+// without restriction, including without limitation the rights to use, copy, modify,    //
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to    //
+// permit persons to whom the Software is furnished to do so, subject to the following   //
+// conditions:                                                                           //
+//                                                                                       //
+// The above copyright notice and this permission notice shall be included in all copies //
+// or substantial portions of the Software.                                              //
+//                                                                                       //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,   //
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A         //
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT    //
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION     //
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE        //
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                                //
+///////////////////////////////////////////////////////////////////////////////////////////
@@ -15,50 +15,40 @@
 #include "SpinCompiler/Parser/ConstantExpressionParser.h"
 #include "SpinCompiler/Parser/AbstractParser.h"
 #include "SpinCompiler/Parser/ParsedObject.h"
-#include <functional>
+#include <map>
 
 class ConSectionParser {
 public:
-    explicit ConSectionParser(TokenReader& reader, ParserObjectContext& objectContext):m_reader(reader),m_objectContext(objectContext),m_enumValid(false) {}
-    void parseConBlocks(int pass) {
+    explicit ConSectionParser(TokenReader& reader, ParserObjectContext& objectContext):m_reader(reader),m_objectContext(objectContext),m_enumPending(-1) {}
+
+    //reads all con blocks once, definitions which can not be resolved yet (forward references of any depth
+    //are resolved here) are kept in pendingConstants until the child objects are loaded
+    void parseConBlocks() {
         m_reader.reset();
         do {
-            m_enumValid = true;
             m_enumValue = ConstantValueExpression::create(m_reader.getSourcePosition(),0);
+            m_enumPending = -1;
             while (true) {
                 auto tk = m_reader.getNextNonBlockOrNewlineToken();
                 if (tk.eof)
                     break;
-
-                while(true) {
-                    if (auto conSym = std::dynamic_pointer_cast<SpinConstantSymbol>(tk.resolvedSymbol)) { // constant
-                        if (pass == 0)
-                            throw CompilerError(ErrorType::eaucnop, tk);
-                        handleConSymbol(pass, tk.symbolId, std::bind(&ConSectionParser::conAssignVerify,this,!conSym->isInteger,conSym->expression,std::placeholders::_1,std::placeholders::_2,std::placeholders::_3,std::placeholders::_4));
-                    }
-                    else if (tk.type == Token::Undefined)
-                        handleConSymbol(pass, tk.symbolId, std::bind(&ConSectionParser::conAssignAddSymbol,this,std::placeholders::_1,std::placeholders::_2,std::placeholders::_3,std::placeholders::_4));
-                    else if (tk.type == Token::Pound) {
-                        const auto res = ConstantExpressionParser::tryResolveValueNonAsm(m_reader,m_objectContext.childObjectSymbols,pass == 1, true);
-                        if (res.expression) {
-                            m_enumValid = true;
-                            m_enumValue = res.expression;
-                        }
-                        else
-                            m_enumValid = false;
-                    }
-                    else // we got an element that isn't valid in a con block
-                        throw CompilerError(ErrorType::eaucnop, tk);
-                    if (!m_reader.getCommaOrEnd())
-                        break;
-                    tk = m_reader.getNextToken();
-                    if (tk.eof)
-                        break;
+                const auto line = m_reader.getTokenIndex();
+                if (!m_objectContext.errors.recover([this, &tk]() { parseConLine(tk); })) {
+                    m_reader.setTokenIndex(line); // continue with the next line
+                    m_reader.skipLine();
                 }
             }
         }
         while(m_reader.getNextBlock(BlockType::BlockCON));
+        resolvePendingConstants(false);
+    }
+
+    //resolves the remaining definitions after the child objects are loaded, everything must resolve now
+    void resolvePendingConstants() {
+        resolvePendingConstants(true);
+        m_objectContext.pendingConstants.clear();
     }
+
     void parseDevBlocks() {
         m_reader.reset();
         while (m_reader.getNextBlock(BlockType::BlockDEV)) {
@@ -83,46 +73,181 @@ private:
     TokenReader &m_reader;
     ParserObjectContext& m_objectContext;
     AbstractConstantExpressionP m_enumValue;
-    bool m_enumValid;
+    int m_enumPending; //index of the pending definition holding the current enum value, -1 if m_enumValue is valid
+    std::map<SpinSymbolId,int> m_pendingBySymbol;
+
+    void parseConLine(Token tk) {
+        while(true) {
+            if (tk.type == Token::Undefined && m_pendingBySymbol.find(tk.symbolId) == m_pendingBySymbol.end())
+                handleConSymbol(tk);
+            else if (tk.type == Token::Pound) {
+                const auto expression = m_reader.getTokenIndex();
+                const auto res = tryResolveValue(false, true);
+                if (res.expression) {
+                    m_enumValue = res.expression;
+                    m_enumPending = -1;
+                }
+                else
+                    m_enumPending = addPendingConstant(PendingConstant(PendingConstant::EnumerationStart, SpinSymbolId(), tk.sourcePosition, tk.sourcePosition, expression));
+            }
+            else // we got an element that isn't valid in a con block or a constant name which is already in use
+                throw CompilerError(ErrorType::eaucnop, tk);
+            if (!m_reader.getCommaOrEnd())
+                break;
+            tk = m_reader.getNextToken();
+            if (tk.eof)
+                break;
+        }
+    }
+
+    ConstantExpressionParser::Result tryResolveValue(bool mustResolve, bool isInteger) {
+        return ConstantExpressionParser::tryResolveValueNonAsm(m_reader, m_objectContext.childObjectSymbols, mustResolve, isInteger);
+    }
 
-    void handleConSymbol(int pass, SpinSymbolId symbolId, const std::function<void(bool,AbstractConstantExpressionP,SpinSymbolId,const SourcePosition&)>& assignFunction) {
+    void handleConSymbol(const Token& nameTk) {
         auto tk = m_reader.getNextToken();
         if (tk.type == Token::Equal) {
-            const auto res = ConstantExpressionParser::tryResolveValueNonAsm(m_reader, m_objectContext.childObjectSymbols, pass == 1, false);
+            const auto expression = m_reader.getTokenIndex();
+            const auto res = tryResolveValue(false, false);
             if (res.expression)
-                assignFunction(res.dataType == ConstantExpressionParser::DataType::Float, res.expression, symbolId, tk.sourcePosition);
+                conAssignAddSymbol(res.dataType == ConstantExpressionParser::DataType::Float, res.expression, nameTk.symbolId, tk.sourcePosition);
+            else
+                addPendingConstant(PendingConstant(PendingConstant::Assignment, nameTk.symbolId, nameTk.sourcePosition, tk.sourcePosition, expression));
         }
         else if (tk.type == Token::LeftIndex) { // enumx
-            const auto res = ConstantExpressionParser::tryResolveValueNonAsm(m_reader, m_objectContext.childObjectSymbols, pass == 1, true);
+            const auto expression = m_reader.getTokenIndex();
+            const auto res = tryResolveValue(false, true);
             m_reader.forceElement(Token::RightIndex);
-            if (!res.expression)
-                m_enumValid = false;
-            else if (m_enumValid) {
+            if (m_enumPending < 0 && res.expression) {
                 auto old = m_enumValue;
                 m_enumValue = addExpression(tk.sourcePosition,old,res.expression);
-                assignFunction(false, old, symbolId, tk.sourcePosition);
+                conAssignAddSymbol(false, old, nameTk.symbolId, tk.sourcePosition);
             }
+            else
+                addPendingEnumeration(nameTk, tk.sourcePosition, expression);
         }
         else if (tk.type == Token::Comma || tk.type == Token::End) { // enuma
             m_reader.goBack();
-            if (m_enumValid) {
+            if (m_enumPending < 0) {
                 auto old = m_enumValue;
                 m_enumValue = addExpression(tk.sourcePosition,old,1);
-                assignFunction(false, old, symbolId, tk.sourcePosition);
+                conAssignAddSymbol(false, old, nameTk.symbolId, tk.sourcePosition);
             }
+            else
+                addPendingEnumeration(nameTk, tk.sourcePosition, TokenIndex());
         }
         else
             throw CompilerError(ErrorType::eelcoeol, tk);
     }
 
-    void conAssignVerify(bool assignFloat, AbstractConstantExpressionP assignValue, bool bFloat, AbstractConstantExpressionP expression, SpinSymbolId, const SourcePosition& sourcePosition) {
-        // verify
-        if (assignFloat != bFloat /*|| assignValue != expression*/) //TODO was besagt dieser check?
-            throw CompilerError(ErrorType::siad, sourcePosition);
+    void addPendingEnumeration(const Token& nameTk, const SourcePosition& sourcePosition, TokenIndex expression) {
+        PendingConstant con(PendingConstant::Enumeration, nameTk.symbolId, nameTk.sourcePosition, sourcePosition, expression);
+        con.previous = m_enumPending;
+        if (m_enumPending < 0)
+            con.enumValue = m_enumValue;
+        m_enumPending = addPendingConstant(con);
+    }
+
+    int addPendingConstant(PendingConstant con) {
+        if (con.expression.valid()) { //collect the undefined symbols of the expression, skipping child object constant names
+            const auto end = m_reader.getTokenIndex();
+            m_reader.setTokenIndex(con.expression);
+            while (m_reader.getTokenIndex() < end) {
+                const auto tk = m_reader.getNextToken();
+                if (tk.type == Token::Pound)
+                    m_reader.skipToken();
+                else if (tk.type == Token::Undefined)
+                    con.dependencies.push_back(std::make_pair(tk.symbolId, tk.sourcePosition));
+            }
+            m_reader.setTokenIndex(end);
+        }
+        auto& pending = m_objectContext.pendingConstants;
+        if (con.symbolId.valid())
+            m_pendingBySymbol[con.symbolId] = int(pending.size());
+        pending.push_back(con);
+        return int(pending.size())-1;
+    }
+
+    void resolvePendingConstants(bool mustResolve) {
+        auto& pending = m_objectContext.pendingConstants;
+        m_pendingBySymbol.clear();
+        for (int i=0; i<int(pending.size()); ++i)
+            if (pending[i].symbolId.valid())
+                m_pendingBySymbol[pending[i].symbolId] = i;
+        for (int i=0; i<int(pending.size()); ++i) {
+            if (!m_objectContext.errors.recover([this, i, mustResolve]() { resolvePendingConstant(i, mustResolve); })) {
+                for (auto& con:pending) // definitions on the path to the error are given up, their users too
+                    if (con.state == PendingConstant::Resolving)
+                        con.state = PendingConstant::Failed;
+            }
+        }
+        for (auto& con:pending)
+            if (con.state == PendingConstant::Failed)
+                con.state = PendingConstant::Unresolved;
+    }
+
+    bool resolveDependency(int index, const SourcePosition& referencePosition, bool mustResolve) {
+        if (m_objectContext.pendingConstants[index].state == PendingConstant::Resolving) {
+            if (mustResolve)
+                throw CompilerError(ErrorType::cdic, referencePosition);
+            return true;
+        }
+        return resolvePendingConstant(index, mustResolve);
+    }
+
+    //resolves all definitions the given one depends on first, returns false if it can not be resolved yet
+    bool resolvePendingConstant(int index, bool mustResolve) {
+        auto& pending = m_objectContext.pendingConstants;
+        PendingConstant& con = pending[index];
+        if (con.state != PendingConstant::Unresolved)
+            return con.state == PendingConstant::Resolved;
+        con.state = PendingConstant::Resolving;
+        bool dependencyFailed = false;
+        if (con.previous >= 0)
+            dependencyFailed |= !resolveDependency(con.previous, con.namePosition, mustResolve);
+        for (const auto& dependency:con.dependencies) {
+            auto it = m_pendingBySymbol.find(dependency.first);
+            if (it != m_pendingBySymbol.end())
+                dependencyFailed |= !resolveDependency(it->second, dependency.second, mustResolve);
+        }
+        if (mustResolve && dependencyFailed) { // the error of the dependency is already reported
+            con.state = PendingConstant::Failed;
+            return false;
+        }
+
+        auto enumValue = con.enumValue;
+        if (con.previous >= 0)
+            enumValue = pending[con.previous].state == PendingConstant::Resolved ? pending[con.previous].enumValue : AbstractConstantExpressionP();
+        ConstantExpressionParser::Result res(ConstantExpressionParser::DataType::Any);
+        if (con.expression.valid()) {
+            m_reader.setTokenIndex(con.expression);
+            res = tryResolveValue(mustResolve, con.type != PendingConstant::Assignment);
+        }
+        if ((con.expression.valid() && !res.expression) || (con.type == PendingConstant::Enumeration && !enumValue)) {
+            con.state = PendingConstant::Failed;
+            return false;
+        }
+        if (con.type != PendingConstant::EnumerationStart && m_objectContext.globalSymbols.hasSymbol(con.symbolId, 0))
+            throw CompilerError(ErrorType::eaucnop, con.namePosition);
+
+        switch (con.type) {
+            case PendingConstant::Assignment:
+                conAssignAddSymbol(res.dataType == ConstantExpressionParser::DataType::Float, res.expression, con.symbolId, con.sourcePosition);
+                break;
+            case PendingConstant::EnumerationStart:
+                con.enumValue = res.expression;
+                break;
+            case PendingConstant::Enumeration:
+                con.enumValue = res.expression ? addExpression(con.sourcePosition,enumValue,res.expression) : addExpression(con.sourcePosition,enumValue,1);
+                conAssignAddSymbol(false, enumValue, con.symbolId, con.sourcePosition);
+                break;
+        }
+        con.state = PendingConstant::Resolved;
+        return true;
     }
 
     void conAssignAddSymbol(bool bFloat, AbstractConstantExpressionP expression, SpinSymbolId symbolId, const SourcePosition& sourcePosition) {
-        m_objectContext.currentObject->constants.push_back(ParsedObject::Constant(sourcePosition,symbolId,expression,bFloat));
+        m_objectContext.currentObject->addConstant(ParsedObject::Constant(sourcePosition,symbolId,expression,bFloat));
         m_objectContext.globalSymbols.addSymbol(symbolId, SpinAbstractSymbolP(new SpinConstantSymbol(expression, !bFloat)), 0);
     }
 
@@ -130,13 +255,13 @@ private:
         int leftValue=0, rightValue=0;
         if (left->isConstant(&leftValue) && right->isConstant(&rightValue))
             return AbstractConstantExpressionP(ConstantValueExpression::create(position, leftValue+rightValue));
-        return AbstractConstantExpressionP(new BinaryConstantExpression(position,left,OperatorType::OpAdd,right,false));
+        return AstArena::create<BinaryConstantExpression>(position,left,OperatorType::OpAdd,right,false);
     }
     AbstractConstantExpressionP addExpression(const SourcePosition& position, AbstractConstantExpressionP left, int rightValue) {
         int leftValue=0;
         if (left->isConstant(&leftValue))
             return AbstractConstantExpressionP(ConstantValueExpression::create(position, leftValue+rightValue));
-        return AbstractConstantExpressionP(new BinaryConstantExpression(position,left,OperatorType::OpAdd,ConstantValueExpression::create(position, rightValue),false));
+        return AstArena::create<BinaryConstantExpression>(position,left,OperatorType::OpAdd,ConstantValueExpression::create(position, rightValue),false);
     }
 };
 
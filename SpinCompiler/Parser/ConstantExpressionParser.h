@@ -13,6 +13,7 @@
 
 #include "SpinCompiler/Types/ConstantExpression.h"
 #include "SpinCompiler/Tokenizer/TokenReader.h"
+#include "SpinCompiler/Parser/ChildObjectSymbols.h"
 
 class ConstantExpressionParser {
 public:
@@ -24,7 +25,7 @@ public:
     };
 private:
     TokenReader &m_reader;
-    const SymbolMap &m_childObjectSymbols;
+    const ChildObjectSymbols &m_childObjectSymbols;
     DatSectionContext *m_datSectionContext;
     bool m_mustResolve;             // the expression must resolve
 public:
@@ -36,15 +37,15 @@ public:
         DataType dataType;
     };
 
-    static Result tryResolveValueNonAsm(TokenReader &reader, const SymbolMap &childObjectSymbols, bool mustResolve, bool isInteger) {
+    static Result tryResolveValueNonAsm(TokenReader &reader, const ChildObjectSymbols &childObjectSymbols, bool mustResolve, bool isInteger) {
         return ConstantExpressionParser(reader, childObjectSymbols, mustResolve, nullptr).resolveExpression(isInteger ? DataType::Integer : DataType::Any);
     }
 
-    static AbstractConstantExpressionP tryResolveValueAsm(TokenReader &reader, const SymbolMap &childObjectSymbols, bool mustResolve, bool isInteger, DatSectionContext *datSectionContext) {
+    static AbstractConstantExpressionP tryResolveValueAsm(TokenReader &reader, const ChildObjectSymbols &childObjectSymbols, bool mustResolve, bool isInteger, DatSectionContext *datSectionContext) {
         return ConstantExpressionParser(reader, childObjectSymbols, mustResolve, datSectionContext).resolveExpression(isInteger ? DataType::Integer : DataType::Any).expression;
     }
 private:
-    ConstantExpressionParser(TokenReader &reader, const SymbolMap &childObjectSymbols, bool mustResolve, DatSectionContext *datSectionContext):
+    ConstantExpressionParser(TokenReader &reader, const ChildObjectSymbols &childObjectSymbols, bool mustResolve, DatSectionContext *datSectionContext):
         m_reader(reader),
         m_childObjectSymbols(childObjectSymbols),
         m_datSectionContext(datSectionContext),
@@ -53,28 +54,31 @@ private:
     }
 
     Result resolveExpression(const DataType expectedDataType) {
-        return resolveSubExpression(10, expectedDataType); //11-1
+        return resolveSubExpression(10, expectedDataType);
     }
 
-    Result resolveSubExpression(int precedence, const DataType expectedDataType) {
-        Result res = (precedence < 0) ? getTerm(precedence, expectedDataType) : resolveSubExpression(precedence - 1, expectedDataType);
+    // precedence climbing: resolves a term followed by any binary operators with precedence <= maxPrecedence
+    // (lower value binds stronger, all binary operators are left associative)
+    Result resolveSubExpression(int maxPrecedence, const DataType expectedDataType) {
+        Result res = getTerm(expectedDataType);
         while (true) {
             auto tk = m_reader.getNextToken();
             if (tk.type != Token::Binary) {
                 m_reader.goBack();
                 return res;
             }
+            // checked before the precedence, an operator not allowed for the current data type is an error at any level
             auto expDtOp2 = previewOp(tk.sourcePosition, tk.opType,res.dataType);
-            if (precedence != tk.value) {
+            if (tk.value > maxPrecedence) {
                 m_reader.goBack();
                 return res;
             }
-            const auto right = resolveSubExpression(precedence - 1, expDtOp2);
+            const auto right = resolveSubExpression(tk.value - 1, expDtOp2);
             res = performBinary(res,static_cast<OperatorType::Type>(tk.opType),right,tk.sourcePosition);
         }
     }
 
-    Result getTerm(int& precedence, const DataType expectedDataType) {
+    Result getTerm(const DataType expectedDataType) {
         // skip over any leading +'s
         auto tk = m_reader.getNextToken();
         while (!tk.eof && tk.type == Token::Binary && tk.opType == OperatorType::OpAdd)
@@ -83,13 +87,11 @@ private:
         if (constRes.dataType != DataType::Illg)
             return constRes;
 
-        if (tk.subToNeg())
-            precedence = 0;
+        tk.subToNeg();
 
         if (tk.type  == Token::Unary) {
             auto expParamDt = previewOp(tk.sourcePosition, tk.opType,expectedDataType);
-            precedence = tk.value; // for unary types, value = precedence
-            const auto res = resolveSubExpression(precedence - 1, expParamDt);
+            const auto res = resolveSubExpression(tk.value - 1, expParamDt); // for unary types, value = precedence
             return performUnary(res,static_cast<OperatorType::Type>(tk.opType),tk.sourcePosition);
         }
         if (tk.type == Token::LeftBracket) {
@@ -135,7 +137,7 @@ private:
         int value=0;
         if (expression->isConstant(&value))
             return Result(ConstantValueExpression::create(sourcePosition, UnaryConstantExpression::performOpUnary(value, operation, floatMode, sourcePosition)), dataType);
-        return Result(AbstractConstantExpressionP(new UnaryConstantExpression(sourcePosition, expression, operation, floatMode)), dataType);
+        return Result(AstArena::create<UnaryConstantExpression>(sourcePosition, expression, operation, floatMode), dataType);
     }
 
     Result checkConstant(Token &tk0, const DataType expectedDataType) {
@@ -190,7 +192,7 @@ private:
         if (tk0.type == Token::AsmOrg) {
             if (!m_datSectionContext)
                 throw CompilerError(ErrorType::oinah, tk0);
-            return Result(AbstractConstantExpressionP(new DatCurrentCogPosConstantExpression(tk0.sourcePosition)), expectedDataType);
+            return Result(AstArena::create<DatCurrentCogPosConstantExpression>(tk0.sourcePosition), expectedDataType);
         }
         if (tk0.type == Token::AsmReg) {
             if (!m_datSectionContext)
@@ -202,7 +204,7 @@ private:
         if (auto objSym = std::dynamic_pointer_cast<SpinObjSymbol>(tk0.resolvedSymbol)) {
             m_reader.forceElement(Token::Pound);
             auto tk1 = m_reader.getNextToken();
-            auto conSym = m_childObjectSymbols.hasSpecificSymbol<SpinConstantSymbol>(tk1.symbolId, objSym->objectClass.value());
+            auto conSym = m_childObjectSymbols.hasConstant(tk1.symbolId, objSym->objectClass);
             if (!conSym)
                 throw CompilerError(ErrorType::eacn, tk1);
             return checkConstant(tk0.sourcePosition, conSym, expectedDataType);
@@ -212,7 +214,7 @@ private:
                 throw CompilerError(ErrorType::fpnaiie, tk0);
             tk0=m_reader.getNextToken();
             if (auto datSym = checkDat(tk0))
-                return Result(AbstractConstantExpressionP(new DatSymbolConstantExpression(tk0.sourcePosition, datSym->id, false)), DataType::Integer);
+                return Result(AstArena::create<DatSymbolConstantExpression>(tk0.sourcePosition, datSym->id, false), DataType::Integer);
             if (tk0.type != Token::Undefined)
                 throw CompilerError(ErrorType::eads, tk0);
             checkUndefined();
@@ -222,8 +224,8 @@ private:
             if (expectedDataType == DataType::Float)
                 throw CompilerError(ErrorType::fpnaiie, tk0);
             if (!m_datSectionContext)
-                return Result(AbstractConstantExpressionP(new DatSymbolConstantExpression(tk0.sourcePosition, datSym->id, false)), DataType::Integer);
-            return Result(AbstractConstantExpressionP(new DatSymbolConstantExpression(tk0.sourcePosition, datSym->id, true)), DataType::Integer);
+                return Result(AstArena::create<DatSymbolConstantExpression>(tk0.sourcePosition, datSym->id, false), DataType::Integer);
+            return Result(AstArena::create<DatSymbolConstantExpression>(tk0.sourcePosition, datSym->id, true), DataType::Integer);
         }
         return Result(DataType::Illg);
     }
@@ -243,19 +245,20 @@ private:
     Result performBinary(const Result left, OperatorType::Type operation, const Result right, const SourcePosition& sourcePosition) {
         if (!left.expression || !right.expression) //undefined
             return Result(right.dataType);
-        auto leftConst=std::dynamic_pointer_cast<ConstantValueExpression>(left.expression);
-        auto rightConst=std::dynamic_pointer_cast<ConstantValueExpression>(right.expression);
-        if (leftConst && rightConst) //if both can be evaluated now, then do it
-            return Result(ConstantValueExpression::create(sourcePosition, BinaryConstantExpression::performOpBinary(leftConst->value, rightConst->value, static_cast<OperatorType::Type>(operation), right.dataType == DataType::Float)), right.dataType);
-        return Result(AbstractConstantExpressionP(new BinaryConstantExpression(sourcePosition, left.expression, operation, right.expression, right.dataType == DataType::Float)), right.dataType);
+        int leftValue = 0;
+        int rightValue = 0;
+        if (left.expression->isConstant(&leftValue) && right.expression->isConstant(&rightValue)) //if both can be evaluated now, then do it
+            return Result(ConstantValueExpression::create(sourcePosition, BinaryConstantExpression::performOpBinary(leftValue, rightValue, static_cast<OperatorType::Type>(operation), right.dataType == DataType::Float)), right.dataType);
+        return Result(AstArena::create<BinaryConstantExpression>(sourcePosition, left.expression, operation, right.expression, right.dataType == DataType::Float), right.dataType);
     }
 
     Result performUnary(const Result param, OperatorType::Type operation, const SourcePosition& sourcePosition) {
         if (!param.expression)
             return Result(param.dataType);
-        if (auto constParam = std::dynamic_pointer_cast<ConstantValueExpression>(param.expression))
-            return Result(ConstantValueExpression::create(sourcePosition, UnaryConstantExpression::performOpUnary(constParam->value, static_cast<OperatorType::Type>(operation), param.dataType == DataType::Float, sourcePosition)), param.dataType);
-        return Result(AbstractConstantExpressionP(new UnaryConstantExpression(sourcePosition, param.expression, operation, param.dataType == DataType::Float)), param.dataType);
+        int paramValue = 0;
+        if (param.expression->isConstant(&paramValue))
+            return Result(ConstantValueExpression::create(sourcePosition, UnaryConstantExpression::performOpUnary(paramValue, static_cast<OperatorType::Type>(operation), param.dataType == DataType::Float, sourcePosition)), param.dataType);
+        return Result(AstArena::create<UnaryConstantExpression>(sourcePosition, param.expression, operation, param.dataType == DataType::Float), param.dataType);
     }
 };
 
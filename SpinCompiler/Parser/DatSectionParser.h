@@ -19,23 +19,36 @@
 
 class DatSectionParser {
 public:
-    DatSectionParser(TokenReader& reader, ParserObjectContext& objectContext):m_reader(reader),m_objectContext(objectContext),m_pass(0),m_orgXMode(false) {}
+    DatSectionParser(TokenReader& reader, ParserObjectContext& objectContext):m_reader(reader),m_objectContext(objectContext),m_orgXMode(false) {}
     void parseDatBlocks() {
-        for (m_pass = 0; m_pass < 2; m_pass++) {
-            m_objectContext.currentObject->clearDatSection();
-            m_datSectionContext.asmLocal = 0;
-            m_reader.reset();
-            int size = 0;
-            while(m_reader.getNextBlock(BlockType::BlockDAT))
-                parseSingleDatBlock(size);
-        }
+        m_objectContext.currentObject->clearDatSection();
+        m_datSectionContext.asmLocal = 0;
+        m_reader.reset();
+        int size = 0;
+        while(m_reader.getNextBlock(BlockType::BlockDAT))
+            parseSingleDatBlock(size);
+        resolveFixups();
     }
 private:
+    //expression using a symbol which is not known yet, parsed again when all dat symbols are defined
+    struct Fixup {
+        Fixup(int datCodeIndex, bool dstOrCount, TokenIndex expression, bool isInteger, int asmLocal):datCodeIndex(datCodeIndex),dstOrCount(dstOrCount),expression(expression),isInteger(isInteger),asmLocal(asmLocal) {}
+        Fixup(int datCodeIndex, SpinSymbolId callSymbolId, SpinSymbolId callRetSymbolId, const SourcePosition& sourcePosition):datCodeIndex(datCodeIndex),dstOrCount(false),isInteger(true),asmLocal(0),callSymbolId(callSymbolId),callRetSymbolId(callRetSymbolId),sourcePosition(sourcePosition) {}
+        int datCodeIndex;
+        bool dstOrCount; //expression to replace in the dat code entry
+        TokenIndex expression; //invalid for call instructions
+        bool isInteger;
+        int asmLocal;
+        SpinSymbolId callSymbolId;
+        SpinSymbolId callRetSymbolId;
+        SourcePosition sourcePosition;
+    };
+
     TokenReader &m_reader;
     ParserObjectContext &m_objectContext;
     ConstantExpressionParser::DatSectionContext m_datSectionContext;
-    int m_pass;
     bool m_orgXMode;
+    std::vector<Fixup> m_fixups;
 
     struct CurrentSymbolInfo {
         explicit CurrentSymbolInfo(int& size):size(size),bResSymbol(false),bLocal(false) {}
@@ -57,6 +70,33 @@ private:
         return tryResolveValue(true, true);
     }
 
+    //the dat code entry using the expression must be the next one appended
+    AbstractConstantExpressionP resolveValueOrAddFixup(bool isInteger, bool dstOrCount) {
+        const auto expression = m_reader.getTokenIndex();
+        auto result = tryResolveValue(false, isInteger);
+        if (!result)
+            m_fixups.push_back(Fixup(int(m_objectContext.currentObject->datCode.size()), dstOrCount, expression, isInteger, m_datSectionContext.asmLocal));
+        return result;
+    }
+
+    void resolveFixups() {
+        auto& datCode = m_objectContext.currentObject->datCode;
+        for (const auto& fixup:m_fixups) {
+            m_objectContext.errors.recover([this, &datCode, &fixup]() {
+                auto& entry = datCode[fixup.datCodeIndex];
+                if (!fixup.expression.valid()) {
+                    entry.srcOrValue = validateCallSymbol(fixup.sourcePosition, false, fixup.callSymbolId); // set #label
+                    entry.dstOrCount = validateCallSymbol(fixup.sourcePosition, true, fixup.callRetSymbolId); // set label_ret
+                    return;
+                }
+                m_reader.setTokenIndex(fixup.expression);
+                m_datSectionContext.asmLocal = fixup.asmLocal;
+                (fixup.dstOrCount ? entry.dstOrCount : entry.srcOrValue) = tryResolveValue(true, fixup.isInteger);
+            });
+        }
+        m_fixups.clear();
+    }
+
     void appendSymbolIfGiven(const SourcePosition& sourcePosition, const CurrentSymbolInfo& symbol, bool align) {
         if (align)
             m_objectContext.currentObject->datCode.push_back(DatCodeEntry(sourcePosition, DatCodeEntry::Align,symbol.size,AbstractConstantExpressionP(),AbstractConstantExpressionP()));
@@ -66,18 +106,8 @@ private:
         auto& symbolTable = symbol.bLocal ? m_datSectionContext.localSymbols : m_objectContext.globalSymbols;
         const int symbolClass = symbol.bLocal ? m_datSectionContext.asmLocal : 0;
 
-        DatSymbolId datSymbolId;
-        if (m_pass == 0) {
-            datSymbolId = m_objectContext.currentObject->reserveNextDatSymbolId();
-            SpinAbstractSymbolP s(new SpinDatSectionSymbol(datSymbolId, symbol.size, symbol.bResSymbol));
-            symbolTable.addSymbol(symbol.symbolId, s, symbolClass);
-        }
-        else {
-            auto sym = symbolTable.hasSpecificSymbol<SpinDatSectionSymbol>(symbol.symbolId, symbolClass);
-            if (!sym || sym->isRes != symbol.bResSymbol || sym->size != symbol.size)
-                throw CompilerError(ErrorType::internal, sourcePosition);
-            datSymbolId = sym->id;
-        }
+        const DatSymbolId datSymbolId = m_objectContext.currentObject->reserveNextDatSymbolId();
+        symbolTable.addSymbol(symbol.symbolId, SpinAbstractSymbolP(new SpinDatSectionSymbol(datSymbolId, symbol.size, symbol.bResSymbol)), symbolClass);
         m_objectContext.currentObject->datCode.push_back(DatCodeEntry(sourcePosition, datSymbolId));
     }
 
@@ -117,7 +147,7 @@ private:
             else // no, backup
                 m_reader.goBack();
             // get the value
-            const AbstractConstantExpressionP value = tryResolveValue(m_pass == 1, overrideSize != 2);
+            const AbstractConstantExpressionP value = resolveValueOrAddFixup(overrideSize != 2, false);
             // get the count
             AbstractConstantExpressionP count;
             if (m_reader.checkElement(Token::LeftIndex)) {
@@ -139,7 +169,7 @@ private:
         symbol.size = 0; // force size to byte
         appendSymbolIfGiven(sourcePosition, symbol, false);
         std::string fileName = m_reader.readFileNameString();
-        auto f = m_objectContext.parser->fileHandler->findFile(fileName, AbstractFileHandler::BinaryDatFile, FileDescriptorP(), sourcePosition);
+        auto f = m_objectContext.parser->findFile(fileName, AbstractFileHandler::BinaryDatFile, sourcePosition);
         for (unsigned char c:f->content)
             appendFixedByte(sourcePosition, c);
         m_reader.forceElement(Token::End);
@@ -209,7 +239,7 @@ private:
         auto datSymbol = m_objectContext.globalSymbols.hasSpecificSymbol<SpinDatSectionSymbol>(symbolId, 0);
         if (!datSymbol)
             throw CompilerError(ErrorType::eads, sourcePosition);
-        return AbstractConstantExpressionP(new DatSymbolConstantExpression(sourcePosition, datSymbol->id, true));
+        return AstArena::create<DatSymbolConstantExpression>(sourcePosition, datSymbol->id, true);
     }
 
     void parseAsmInstruction(const SourcePosition& sourcePosition, CurrentSymbolInfo& symbol, unsigned char condition, const Token& tk0) {
@@ -234,7 +264,7 @@ private:
         if (opcode & 0x80) { // sys instruction
             instruction |= 0x00400000; // set immediate
             instruction |= (opcode & 0x07); // set s
-            dstExpression = tryResolveInteger(m_pass == 1);
+            dstExpression = resolveValueOrAddFixup(true, true);
         }
         else if (opcode == 0x15) { // call?
             // make 'jmpret label_ret, #label'
@@ -245,13 +275,10 @@ private:
             if (!tk1.isValidWordSymbol())
                 throw CompilerError(ErrorType::eads, tk1);
             auto symbolId = tk1.symbolId;
-            if (m_pass != 0)
-                srcExpression = validateCallSymbol(tk1.sourcePosition, false, symbolId); // set #label
-
             auto retSymbolName = m_objectContext.parser->stringMap.getNameBySymbolId(symbolId)+"_RET";
             auto retSymbolId = m_objectContext.parser->stringMap.getOrPutSymbolName(retSymbolName);
-            if (m_pass != 0)
-                dstExpression = validateCallSymbol(tk1.sourcePosition, true, retSymbolId); // set label_ret
+            // label and label_ret are set when all dat symbols are known
+            m_fixups.push_back(Fixup(int(m_objectContext.currentObject->datCode.size()), symbolId, retSymbolId, tk1.sourcePosition));
         }
         else if (opcode == 0x16) // ret?
             instruction ^= 0x04400000; // make 'jmp #0'
@@ -263,15 +290,15 @@ private:
                 instruction |= 0x00400000;
             else
                 m_reader.goBack();
-            srcExpression = tryResolveInteger(m_pass == 1); // set s on instruction
+            srcExpression = resolveValueOrAddFixup(true, false); // set s on instruction
         }
         else { // regular instruction get both d and s
-            dstExpression = tryResolveInteger(m_pass == 1); // set d on instruction
+            dstExpression = resolveValueOrAddFixup(true, true); // set d on instruction
             m_reader.forceElement(Token::Comma);
             // see if it's an immediate value for s
             if (m_reader.checkElement(Token::Pound))
                 instruction |= 0x00400000;
-            srcExpression = tryResolveInteger(m_pass == 1); // set s on instruction
+            srcExpression = resolveValueOrAddFixup(true, false); // set s on instruction
         }
 
         // check for effects
@@ -329,55 +356,55 @@ private:
             auto tk = m_reader.getNextNonBlockOrNewlineToken();
             if (tk.eof)
                 break;
-            // clear symbol flags
-            CurrentSymbolInfo symbol(symSize);
-            symbol.bLocal = (tk.type == Token::Colon); //local symbol?
-            if (symbol.bLocal) {
-                tk = m_reader.getNextToken();
-                if (!tk.isValidWordSymbol())
-                    throw CompilerError(ErrorType::eals, tk);
-                symbol.symbolId = tk.symbolId;
-                tk.resolvedSymbol = m_datSectionContext.localSymbols.hasSpecificSymbol<SpinDatSectionSymbol>(tk.symbolId, m_datSectionContext.asmLocal);
-                tk.type = tk.resolvedSymbol ? Token::DefinedSymbol : Token::Undefined;
+            const auto line = m_reader.getTokenIndex();
+            const auto fixupCount = m_fixups.size();
+            if (!m_objectContext.errors.recover([this, &tk, &symSize]() { parseDatLine(tk, symSize); })) {
+                m_fixups.erase(m_fixups.begin()+fixupCount, m_fixups.end()); // drop fixups of the failed line, their dat code entry might be missing
+                m_reader.setTokenIndex(line);
+                m_reader.skipLine();
             }
+        }
+    }
 
-            if (tk.type == Token::Undefined) { // undefined here means it's a symbol
-                if (!symbol.bLocal) {
-                    symbol.symbolId = tk.symbolId;
-                    m_datSectionContext.asmLocal++;
-                }
-                tk = m_reader.getNextToken();
-                if (tk.type == Token::End) {
-                    appendSymbolIfGiven(tk.sourcePosition, symbol, false);
-                    continue;
-                }
-            }
-            else if (std::dynamic_pointer_cast<SpinDatSectionSymbol>(tk.resolvedSymbol)) {
+    void parseDatLine(Token tk, int &symSize) {
+        // clear symbol flags
+        CurrentSymbolInfo symbol(symSize);
+        symbol.bLocal = (tk.type == Token::Colon); //local symbol?
+        if (symbol.bLocal) {
+            tk = m_reader.getNextToken();
+            if (!tk.isValidWordSymbol())
+                throw CompilerError(ErrorType::eals, tk);
+            symbol.symbolId = tk.symbolId;
+            tk.resolvedSymbol = m_datSectionContext.localSymbols.hasSpecificSymbol<SpinDatSectionSymbol>(tk.symbolId, m_datSectionContext.asmLocal);
+            tk.type = tk.resolvedSymbol ? Token::DefinedSymbol : Token::Undefined;
+        }
+
+        if (tk.type == Token::Undefined) { // undefined here means it's a symbol
+            if (!symbol.bLocal) {
                 symbol.symbolId = tk.symbolId;
-                if (!symbol.bLocal)
-                    m_datSectionContext.asmLocal++;
-                if (m_pass == 0)
-                    throw CompilerError(ErrorType::siad, tk);
-                tk = m_reader.getNextToken();
-                if (tk.type == Token::End) {
-                    appendSymbolIfGiven(tk.sourcePosition, symbol, false);
-                    continue;
-                }
+                m_datSectionContext.asmLocal++;
+            }
+            tk = m_reader.getNextToken();
+            if (tk.type == Token::End) {
+                appendSymbolIfGiven(tk.sourcePosition, symbol, false);
+                return;
             }
-
-            if (tk.type == Token::Size)
-                parseData(tk.sourcePosition, symbol, tk.value);
-            else if (tk.type == Token::File)
-                parseDatFile(tk.sourcePosition, symbol);
-            else if (tk.type == Token::AsmDir)
-                parseAsmDirective(tk.sourcePosition, symbol, tk.value);
-            else if (tk.type == Token::AsmCond)
-                parseAsmCondition(tk.sourcePosition, symbol, tk.value);
-            else if (checkInstruction(tk))
-                parseAsmInstruction(tk.sourcePosition, symbol, AsmConditionType::IfAlways, tk);
-            else
-                throw CompilerError(ErrorType::eaunbwlo, tk);
         }
+        else if (std::dynamic_pointer_cast<SpinDatSectionSymbol>(tk.resolvedSymbol))
+            throw CompilerError(ErrorType::siad, tk);
+
+        if (tk.type == Token::Size)
+            parseData(tk.sourcePosition, symbol, tk.value);
+        else if (tk.type == Token::File)
+            parseDatFile(tk.sourcePosition, symbol);
+        else if (tk.type == Token::AsmDir)
+            parseAsmDirective(tk.sourcePosition, symbol, tk.value);
+        else if (tk.type == Token::AsmCond)
+            parseAsmCondition(tk.sourcePosition, symbol, tk.value);
+        else if (checkInstruction(tk))
+            parseAsmInstruction(tk.sourcePosition, symbol, AsmConditionType::IfAlways, tk);
+        else
+            throw CompilerError(ErrorType::eaunbwlo, tk);
     }
 };
 
@@ -53,13 +53,13 @@ public:
     }
 
     AbstractExpressionP compileVariableSideEffectOperation(int vOperator, AbstractSpinVariableP varInfo) {
-        return AbstractExpressionP(new UnaryAssignExpression(varInfo,vOperator));
+        return AstArena::create<UnaryAssignExpression>(varInfo,vOperator);
     }
 
     AbstractExpressionP compileVariableAssignExpression(OperatorType::Type operation, AbstractSpinVariableP varInfo) {
         auto pos = m_reader.getSourcePosition();
         auto valueExpression = parseExpression();
-        return AbstractExpressionP(new AssignExpression(pos, valueExpression, varInfo, operation));
+        return AstArena::create<AssignExpression>(pos, valueExpression, varInfo, operation);
     }
 
     AbstractExpressionP compileVariablePreSignExtendOrRandom(int vOperator) {
@@ -67,10 +67,9 @@ public:
     }
 
     AbstractExpressionP compileVariableIncOrDec(int vOperator, AbstractSpinVariableP varInfo) {
-        auto cogReg = std::dynamic_pointer_cast<CogRegisterSpinVariable>(varInfo);
-        if (!cogReg || !cogReg->indexExpression)
+        if (varInfo->kind != AbstractSpinVariable::CogRegisterVariable || !static_cast<const CogRegisterSpinVariable&>(*varInfo).indexExpression)
             vOperator |= (((varInfo->size + 1) & 3) << 1);
-        return AbstractExpressionP(new UnaryAssignExpression(varInfo,vOperator));
+        return AstArena::create<UnaryAssignExpression>(varInfo,vOperator);
     }
 
     AbstractExpressionP compileVariablePreIncOrDec(int vOperator) {
@@ -83,7 +82,7 @@ public:
 
     AbstractSpinVariableP getVariable(const Token& tk0, ErrorType errorOnNoVar) {
         if (tk0.type == Token::SPR)
-            return AbstractSpinVariableP(new SpecialPurposeSpinVariable(tk0.sourcePosition,readIndexExpression(true)));
+            return AstArena::create<SpecialPurposeSpinVariable>(tk0.sourcePosition,readIndexExpression(true));
         if (tk0.type == Token::AsmReg) {
             AbstractExpressionP indexExpression;
             AbstractExpressionP indexExpressionUpperRange;
@@ -93,12 +92,12 @@ public:
                     indexExpressionUpperRange = parseExpression();
                 m_reader.forceElement(Token::RightIndex);
             }
-            return AbstractSpinVariableP(new CogRegisterSpinVariable(tk0.sourcePosition, tk0.value, indexExpression, indexExpressionUpperRange));
+            return AstArena::create<CogRegisterSpinVariable>(tk0.sourcePosition, tk0.value, indexExpression, indexExpressionUpperRange);
         }
         if (tk0.type == Token::Size) {
             auto dynamicAddressExpression = readIndexExpression(true);
             auto indexExpression = readIndexExpression(false);
-            return AbstractSpinVariableP(new DirectMemorySpinVariable(tk0.sourcePosition, AbstractSpinVariable::SizeModifier(tk0.value), dynamicAddressExpression, indexExpression));
+            return AstArena::create<DirectMemorySpinVariable>(tk0.sourcePosition, AbstractSpinVariable::SizeModifier(tk0.value), dynamicAddressExpression, indexExpression);
         }
         AbstractSpinVariable::SizeModifier size=AbstractSpinVariable::Long;
         NamedSpinVariable::VarType varType = NamedSpinVariable::LocMemoryAccess;
@@ -137,7 +136,7 @@ public:
                 indexExpression = readIndexExpression(false); //TODO index required?
             }
         }
-        return AbstractSpinVariableP(new NamedSpinVariable(tk0.sourcePosition, size, varType, indexExpression, symbolId));
+        return AstArena::create<NamedSpinVariable>(tk0.sourcePosition, size, varType, indexExpression, symbolId);
     }
 
     // compile obj[].pub
@@ -152,12 +151,12 @@ public:
 
         // compile any parameters the pub has
         auto parameters = parseParameters(method->parameterCount);
-        return AbstractExpressionP(new MethodCallExpression(sourcePosition, parameters, objectIndex, objSymbol->objInstanceId, method->methodId, trapCall));
+        return AstArena::create<MethodCallExpression>(sourcePosition, parameters, objectIndex, objSymbol->objInstanceId, method->methodId, trapCall);
     }
 
     AbstractExpressionP parseMethodCall(const SourcePosition& sourcePosition, SpinSubSymbolP subSymbol, const bool trapCall) {
         auto parameters = parseParameters(subSymbol->parameterCount);
-        return AbstractExpressionP(new MethodCallExpression(sourcePosition, parameters, AbstractExpressionP(), ObjectInstanceId(), subSymbol->methodId, trapCall));
+        return AstArena::create<MethodCallExpression>(sourcePosition, parameters, AbstractExpressionP(), ObjectInstanceId(), subSymbol->methodId, trapCall);
     }
 
     // compile \sub or \obj
@@ -181,14 +180,14 @@ public:
             m_reader.forceElement(Token::Comma);
             auto stackExpression = parseExpression(); // compile stack expression
             m_reader.forceElement(Token::RightBracket);
-            return AbstractExpressionP(new CogNewSpinExpression(sourcePosition, parameters, stackExpression, subSym->methodId));
+            return AstArena::create<CogNewSpinExpression>(sourcePosition, parameters, stackExpression, subSym->methodId);
         }
 
         // it is not a sub, so backup and compile as cognew(address, parameter)
         m_reader.goBack();
         m_reader.goBack();
         auto params = parseParameters(2);
-        return AbstractExpressionP(new CogNewAsmExpression(sourcePosition, params[0], params[1]));
+        return AstArena::create<CogNewAsmExpression>(sourcePosition, params[0], params[1]);
     }
 private:
     ConstantExpressionParser::Result tryParseConstantExpression(bool mustResolve, bool isInteger) {
@@ -196,7 +195,7 @@ private:
     }
 
     AbstractExpressionP parseTopExpression() {
-        return parseBinaryExpression(11);
+        return parseBinaryExpression(10);
     }
 
     AbstractExpressionP compileSubExpressionTermX() {
@@ -210,11 +209,11 @@ private:
 
         switch (tk.type) {
             case Token::AtAt:
-                return AbstractExpressionP(new AtAtExpression(tk.sourcePosition, parseBinaryExpression(0)));
+                return AstArena::create<AtAtExpression>(tk.sourcePosition, parseBinaryExpression(-1));
 
             case Token::Unary:
                 // tk.value = precedence for Token::type_unary
-                return AbstractExpressionP(new UnaryExpression(tk.sourcePosition, parseBinaryExpression(tk.value), OperatorType::Type(tk.opType))); //TODO remove operator cast
+                return AstArena::create<UnaryExpression>(tk.sourcePosition, parseBinaryExpression(tk.value - 1), OperatorType::Type(tk.opType)); //TODO remove operator cast
 
             case Token::LeftBracket: {
                 auto expr = parseTopExpression();
@@ -234,23 +233,24 @@ private:
         if (auto conSym = std::dynamic_pointer_cast<SpinConstantSymbol>(nextTk.resolvedSymbol)) {
             prevToken = nextTk;
             prevToken.symbolId = SpinSymbolId();
-            prevToken.resolvedSymbol = SpinAbstractSymbolP(new SpinConstantSymbol(AbstractConstantExpressionP(new UnaryConstantExpression(prevToken.sourcePosition, conSym->expression, OperatorType::OpNeg, !conSym->isInteger)),conSym->isInteger));
+            prevToken.resolvedSymbol = SpinAbstractSymbolP(new SpinConstantSymbol(AstArena::create<UnaryConstantExpression>(prevToken.sourcePosition, conSym->expression, OperatorType::OpNeg, !conSym->isInteger),conSym->isInteger));
         }
         else
             m_reader.goBack();
     }
 
-    AbstractExpressionP parseBinaryExpression(int precedence) {
-        precedence--;
-        AbstractExpressionP resultExpr = (precedence < 0) ? compileSubExpressionTermX() : parseBinaryExpression(precedence);
+    // precedence climbing: parses a term followed by any binary operators with precedence <= maxPrecedence
+    // (lower value binds stronger, all binary operators are left associative)
+    AbstractExpressionP parseBinaryExpression(int maxPrecedence) {
+        AbstractExpressionP resultExpr = compileSubExpressionTermX();
 
         while(true) {
             auto tk = m_reader.getNextToken();
-            if (tk.type != Token::Binary || tk.value != precedence) {
+            if (tk.type != Token::Binary || tk.value > maxPrecedence) {
                 m_reader.goBack();
                 break;
             }
-            resultExpr = AbstractExpressionP(new BinaryExpression(tk.sourcePosition, resultExpr, parseBinaryExpression(precedence), OperatorType::Type(tk.opType))); //TODO remove operator cast
+            resultExpr = AstArena::create<BinaryExpression>(tk.sourcePosition, resultExpr, parseBinaryExpression(tk.value - 1), OperatorType::Type(tk.opType)); //TODO remove operator cast
         }
         return resultExpr;
     }
@@ -260,7 +260,7 @@ private:
         auto sourcePosition = m_reader.getSourcePosition();
         auto expr = tryParseConstantExpression(true, false).expression;
         m_reader.forceElement(Token::RightBracket);
-        return AbstractExpressionP(new PushConstantExpression(sourcePosition, expr, ConstantEncoding::AutoDetect));
+        return AstArena::create<PushConstantExpression>(sourcePosition, expr, ConstantEncoding::AutoDetect);
     }
 
     // compile string("constantstring")
@@ -283,14 +283,14 @@ private:
         }
         //auto strIdx = m_context.appendStringContant(startSourcePosition, startPosMarker, tmpStr);
         auto strIdx = m_context.stringsCounter++;
-        return AbstractExpressionP(new PushStringExpression(startSourcePosition, tmpStr, strIdx));
+        return AstArena::create<PushStringExpression>(startSourcePosition, tmpStr, strIdx);
     }
 
     // compile float(integer)/round(float)/trunc(float)
     AbstractExpressionP parsePrimaryFloatRoundTrunc() {
         m_reader.goBack(); // backup to float/round/trunc
         auto sourcePosition = m_reader.getSourcePosition();
-        return AbstractExpressionP(new PushConstantExpression(sourcePosition, tryParseConstantExpression(true, false).expression, ConstantEncoding::AutoDetect));
+        return AstArena::create<PushConstantExpression>(sourcePosition, tryParseConstantExpression(true, false).expression, ConstantEncoding::AutoDetect);
     }
 
     // compile obj[].pub\obj[]#con
@@ -299,7 +299,7 @@ private:
             return parseChildObjectMethodCall(objSymbol, false); // not obj#con, so do obj[].pub
         // lookup the symbol to get the value to compile
         auto sourcePosition = m_reader.getSourcePosition();
-        return AbstractExpressionP(new PushConstantExpression(sourcePosition, m_context.objectContext.getObjConstant(m_reader.getNextToken(), objSymbol->objectClass)->expression, ConstantEncoding::AutoDetect));
+        return AstArena::create<PushConstantExpression>(sourcePosition, m_context.objectContext.getObjConstant(m_reader.getNextToken(), objSymbol->objectClass)->expression, ConstantEncoding::AutoDetect);
     }
 
     AbstractExpressionP parseLookExpression(int origTokenByteCode) {
@@ -315,43 +315,43 @@ private:
             if (!m_reader.getCommaOrRight())
                 break;
         }
-        return AbstractExpressionP(new LookExpression(sourcePosition, condition, listExpr, origTokenByteCode));
+        return AstArena::create<LookExpression>(sourcePosition, condition, listExpr, origTokenByteCode);
     }
 
     AbstractExpressionP compileTermClkMode(const SourcePosition& sourcePosition) {
-        return AbstractExpressionP(new VariableExpression(AbstractSpinVariableP(new DirectMemorySpinVariable(
+        return AstArena::create<VariableExpression>(AstArena::create<DirectMemorySpinVariable>(
                 sourcePosition,
                 AbstractSpinVariable::Byte,
-                AbstractExpressionP(new PushConstantExpression(sourcePosition, 4, ConstantEncoding::NoMask)),
+                AstArena::create<PushConstantExpression>(sourcePosition, 4, ConstantEncoding::NoMask),
                 AbstractExpressionP()
-        )),false));
+        ),false);
     }
 
     AbstractExpressionP compileTermClkFreq(const SourcePosition& sourcePosition) {
-        return AbstractExpressionP(new VariableExpression(AbstractSpinVariableP(new DirectMemorySpinVariable(
+        return AstArena::create<VariableExpression>(AstArena::create<DirectMemorySpinVariable>(
                 sourcePosition,
                 AbstractSpinVariable::Long,
-                AbstractExpressionP(new PushConstantExpression(sourcePosition, 0, ConstantEncoding::NoMask)),
+                AstArena::create<PushConstantExpression>(sourcePosition, 0, ConstantEncoding::NoMask),
                 AbstractExpressionP()
-        )),false));
+        ),false);
     }
 
     AbstractExpressionP compileTermChipVer(const SourcePosition& sourcePosition) {
-        return AbstractExpressionP(new VariableExpression(AbstractSpinVariableP(new DirectMemorySpinVariable(
+        return AstArena::create<VariableExpression>(AstArena::create<DirectMemorySpinVariable>(
                 sourcePosition,
                 AbstractSpinVariable::Byte,
-                AbstractExpressionP(new PushConstantExpression(sourcePosition, -1, ConstantEncoding::NoMask)),
+                AstArena::create<PushConstantExpression>(sourcePosition, -1, ConstantEncoding::NoMask),
                 AbstractExpressionP()
-        )),false));
+        ),false);
     }
 
     AbstractExpressionP compileTermCogIdX(const SourcePosition& sourcePosition) {
-        return AbstractExpressionP(new VariableExpression(AbstractSpinVariableP(new CogRegisterSpinVariable(
+        return AstArena::create<VariableExpression>(AstArena::create<CogRegisterSpinVariable>(
                 sourcePosition,
                 9, // read id
                 AbstractExpressionP(),
                 AbstractExpressionP()
-        )),false));
+        ),false);
     }
 
     // compile @var
@@ -359,12 +359,12 @@ private:
         auto varInfo = getVariable();
         if (!varInfo->canTakeReference())
             throw CompilerError(ErrorType::eamvaa, varInfo->sourcePosition);
-        return AbstractExpressionP(new VariableExpression(varInfo,true));
+        return AstArena::create<VariableExpression>(varInfo,true);
     }
 
     AbstractExpressionP parseBuiltInExpression(const Token& tk) {
         auto parameters = parseParameters(tk.unpackBuiltInParameterCount());
-        return AbstractExpressionP(new CallBuiltInExpression(tk.sourcePosition, parameters, BuiltInFunction::Type(tk.unpackBuiltInByteCode())));
+        return AstArena::create<CallBuiltInExpression>(tk.sourcePosition, parameters, BuiltInFunction::Type(tk.unpackBuiltInByteCode()));
     }
 
     AbstractExpressionP parsePrimary(const Token& tk0) {
@@ -381,7 +381,7 @@ private:
                 return parseTryCall(true);
             case Token::DefinedSymbol: {
                 if (auto conSym = std::dynamic_pointer_cast<SpinConstantSymbol>(tk0.resolvedSymbol))
-                    return AbstractExpressionP(new PushConstantExpression(tk0.sourcePosition, conSym->expression, ConstantEncoding::AutoDetect));
+                    return AstArena::create<PushConstantExpression>(tk0.sourcePosition, conSym->expression, ConstantEncoding::AutoDetect);
                 if (auto objSym = std::dynamic_pointer_cast<SpinObjSymbol>(tk0.resolvedSymbol))
                     return parseChildObjectAccess(objSym);
                 if (auto subSym = std::dynamic_pointer_cast<SpinSubSymbol>(tk0.resolvedSymbol))
@@ -447,7 +447,7 @@ private:
             m_reader.goBack(); // not '=' so backup
         }
         m_reader.goBack(); // no post-var modifier, so backup
-        return AbstractExpressionP(new VariableExpression(varInfo,false));
+        return AstArena::create<VariableExpression>(varInfo,false);
     }
 
     AbstractExpressionP readIndexExpression(bool required) {
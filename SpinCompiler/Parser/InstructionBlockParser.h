@@ -16,10 +16,10 @@
 class InstructionBlockParser {
 public:
     explicit InstructionBlockParser(const ParserFunctionContext &context):m_context(context),m_reader(context.reader) {}
-    static AbstractInstructionP compileFunction(TokenReader &reader, ParserObjectContext& objectContext) {
+    static AbstractInstructionP compileFunction(TokenReader &reader, ParserObjectContext& objectContext, CompilerErrorCollector &errors) {
         int stringCounter=0;
         return InstructionBlockParser(ParserFunctionContext(
-                                         reader, objectContext, false,stringCounter
+                                         reader, objectContext, errors, false,stringCounter
                                          )).parseBlock(0,true);
     }
 private:
@@ -35,23 +35,46 @@ private:
             const int tkCol = tk.sourcePosition.column;
             if (tkCol <= column)
                 break;
-            if (tk.type == Token::If)
-                children.push_back(parseCompleteIfOrIfNot(tkCol, false));
-            else if (tk.type == Token::IfNot)
-                children.push_back(parseCompleteIfOrIfNot(tkCol, true));
-            else if (tk.type == Token::Case)
-                children.push_back(parseCase(tkCol));
-            else if (tk.type == Token::Repeat)
-                children.push_back(parseRepeat(tkCol));
-            else {
-                children.push_back(InstructionParser(m_context).parseInstruction(tk));
-                m_reader.forceElement(Token::End);
-            }
+            const TokenIndex statementIndex = m_reader.getTokenIndex();
+            if (!m_context.errors.recover([&]() { children.push_back(parseStatement(tk, tkCol)); }))
+                skipStatement(statementIndex, tk.type, tkCol);
         }
         if (isTopBlock)
-            children.push_back(AbstractInstructionP(new AbortOrReturnInstruction(m_reader.getSourcePosition(), AbstractExpressionP(), false)));
+            children.push_back(AstArena::create<AbortOrReturnInstruction>(m_reader.getSourcePosition(), AbstractExpressionP(), false));
+        m_reader.goBack();
+        return AstArena::create<BlockInstruction>(startSourcePosition, children);
+    }
+
+    AbstractInstructionP parseStatement(Token& tk, int column) {
+        if (tk.type == Token::If)
+            return parseCompleteIfOrIfNot(column, false);
+        if (tk.type == Token::IfNot)
+            return parseCompleteIfOrIfNot(column, true);
+        if (tk.type == Token::Case)
+            return parseCase(column);
+        if (tk.type == Token::Repeat)
+            return parseRepeat(column);
+        auto instruction = InstructionParser(m_context).parseInstruction(tk);
+        m_reader.forceElement(Token::End);
+        return instruction;
+    }
+
+    // skips a failed statement including its indented block and the ELSE/WHILE lines belonging to it
+    void skipStatement(TokenIndex statementIndex, Token::Type type, int column) {
+        m_reader.setTokenIndex(statementIndex);
+        m_reader.skipLine();
+        while (true) {
+            auto tk = m_reader.getNextNonBlockOrNewlineToken();
+            if (tk.eof)
+                break;
+            const int tkCol = tk.sourcePosition.column;
+            const bool continuesIf = (type == Token::If || type == Token::IfNot) && (tk.type == Token::ElseIf || tk.type == Token::ElseIfNot || tk.type == Token::Else);
+            const bool continuesRepeat = type == Token::Repeat && (tk.type == Token::While || tk.type == Token::Until);
+            if (tkCol < column || (tkCol == column && !continuesIf && !continuesRepeat))
+                break;
+            m_reader.skipLine();
+        }
         m_reader.goBack();
-        return BlockInstructionP(new BlockInstruction(startSourcePosition, children));
     }
 
     IfInstruction::Branch parseIfBranch(int column, bool inverted) {
@@ -88,7 +111,7 @@ private:
                 break;
             }
         }
-        return AbstractInstructionP(new IfInstruction(sourcePosition, branches, elseBranch));
+        return AstArena::create<IfInstruction>(sourcePosition, branches, elseBranch);
     }
 
     AbstractInstructionP parseCase(int column) {
@@ -131,7 +154,7 @@ private:
 
         if (cases.empty())
             throw CompilerError(ErrorType::nce);
-        return AbstractInstructionP(new CaseInstruction(sourcePosition, condition, cases, otherInstruction));
+        return AstArena::create<CaseInstruction>(sourcePosition, condition, cases, otherInstruction);
     }
 
     AbstractInstructionP parseEndlessOrPostRepeat(int column){
@@ -145,12 +168,12 @@ private:
                 auto condition = ExpressionParser(m_context,true).parseExpression(); // compile post-while/until expression
                 m_reader.forceElement(Token::End);
                 const auto type = (tk.type == Token::While) ? LoopConditionInstruction::PostWhile : LoopConditionInstruction::PostUntil;
-                return AbstractInstructionP(new LoopConditionInstruction(sourcePosition, type, condition, instruction));
+                return AstArena::create<LoopConditionInstruction>(sourcePosition, type, condition, instruction);
             }
             else
                 m_reader.goBack();
         }
-        return AbstractInstructionP(new LoopConditionInstruction(sourcePosition, LoopConditionInstruction::RepeatEndless, AbstractExpressionP(), instruction));
+        return AstArena::create<LoopConditionInstruction>(sourcePosition, LoopConditionInstruction::RepeatEndless, AbstractExpressionP(), instruction);
     }
 
     AbstractInstructionP parsePreRepeat(int column, LoopConditionInstruction::Type type) {
@@ -158,12 +181,12 @@ private:
         auto condition = ExpressionParser(m_context,true).parseExpression(); // compile pre-while/until expression
         m_reader.forceElement(Token::End);
         auto instruction = parseBlock(column); // compile repeat-while/until block
-        return AbstractInstructionP(new LoopConditionInstruction(sourcePosition, type, condition, instruction));
+        return AstArena::create<LoopConditionInstruction>(sourcePosition, type, condition, instruction);
     }
 
     AbstractInstructionP parseRepeatCount(int column, AbstractExpressionP countExpression) {
         auto instruction = parseBlock(column); // compile repeat-count block
-        return AbstractInstructionP(new LoopConditionInstruction(countExpression->sourcePosition, LoopConditionInstruction::RepeatCount, countExpression, instruction));
+        return AstArena::create<LoopConditionInstruction>(countExpression->sourcePosition, LoopConditionInstruction::RepeatCount, countExpression, instruction);
     }
 
     AbstractInstructionP parseRepeatVariable(int column, AbstractSpinVariableP variable) {
@@ -186,7 +209,7 @@ private:
         }
         else if (tk3.type != Token::End)
             throw CompilerError(ErrorType::esoeol, tk3);
-        return AbstractInstructionP(new LoopVarInstruction(sourcePosition, variable, from, to, step, parseBlock(column)));
+        return AstArena::create<LoopVarInstruction>(sourcePosition, variable, from, to, step, parseBlock(column));
     }
 
     AbstractInstructionP parseRepeat(int column) {
@@ -204,11 +227,13 @@ private:
         auto countExpression = ExpressionParser(m_context,true).parseExpression(); // compile count expression
         if (m_reader.checkElement(Token::End)) // repeat <exp>
             return subCompiler.parseRepeatCount(column, countExpression);
-        auto varExpr = std::dynamic_pointer_cast<VariableExpression>(countExpression);
-        if (!varExpr || varExpr->isReadReference)
+        if (countExpression->kind != AbstractExpression::VariableNode)
+            throw CompilerError(ErrorType::eav, countExpression->sourcePosition);
+        auto& varExpr = static_cast<const VariableExpression&>(*countExpression);
+        if (varExpr.isReadReference)
             throw CompilerError(ErrorType::eav, countExpression->sourcePosition);
         // repeat var from <exp> to <exp> step <exp>
-        return subCompiler.parseRepeatVariable(column, varExpr->variable);
+        return subCompiler.parseRepeatVariable(column, varExpr.variable);
     }
 };
 
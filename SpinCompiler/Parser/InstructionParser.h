@@ -26,13 +26,13 @@ public:
         switch(tk0.type) {
             case Token::DefinedSymbol: {
                 if (auto objSym = std::dynamic_pointer_cast<SpinObjSymbol>(tk0.resolvedSymbol))
-                    return AbstractInstructionP(new ExpressionInstruction(exprCompiler.parseChildObjectMethodCall(objSym, false)));
+                    return AstArena::create<ExpressionInstruction>(exprCompiler.parseChildObjectMethodCall(objSym, false));
                 if (auto subSym = std::dynamic_pointer_cast<SpinSubSymbol>(tk0.resolvedSymbol))
-                    return AbstractInstructionP(new ExpressionInstruction(exprCompiler.parseMethodCall(tk0.sourcePosition, subSym, false)));
+                    return AstArena::create<ExpressionInstruction>(exprCompiler.parseMethodCall(tk0.sourcePosition, subSym, false));
                 break;
             }
             case Token::Backslash:
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.parseTryCall(true)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.parseTryCall(true));
             case Token::NextQuit:
                 return parseNextOrQuit((tk0.value & 0xFF) == 0);
             case Token::Abort:
@@ -42,28 +42,28 @@ public:
             case Token::Reboot:
                 return parseReboot();
             case Token::CogNew:
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.parseCogNew())); // no push;
+                return AstArena::create<ExpressionInstruction>(exprCompiler.parseCogNew()); // no push;
             case Token::CogInit:
                 return parseCogInit(exprCompiler);
             case Token::InstCanReturn: // instruction can-return
-                return AbstractInstructionP(new ExpressionInstruction(AbstractExpressionP(new CallBuiltInExpression(tk0.sourcePosition,
+                return AstArena::create<ExpressionInstruction>(AstArena::create<CallBuiltInExpression>(tk0.sourcePosition,
                                                                                                              exprCompiler.parseParameters(tk0.unpackBuiltInParameterCount()),
                                                                                                              BuiltInFunction::Type(tk0.unpackBuiltInByteCode())
-                                                                                                             ))));
+                                                                                                             ));
             case Token::InstNeverReturn: // instruction never-return
-                return AbstractInstructionP(new CallBuiltInInstruction(tk0.sourcePosition,
+                return AstArena::create<CallBuiltInInstruction>(tk0.sourcePosition,
                                                                        exprCompiler.parseParameters(tk0.unpackBuiltInParameterCount()),
-                                                                       tk0.unpackBuiltInByteCode()));
+                                                                       tk0.unpackBuiltInByteCode());
             case Token::Inc: // assign pre-inc  ++var
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariablePreIncOrDec(0x20)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariablePreIncOrDec(0x20));
             case Token::Dec: // assign pre-dec  --var
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariablePreIncOrDec(0x30)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariablePreIncOrDec(0x30));
             case Token::Tilde: // assign sign-extern byte  ~var
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariablePreSignExtendOrRandom(0x10)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariablePreSignExtendOrRandom(0x10));
             case Token::TildeTilde: // assign sign-extern word  ~~var
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariablePreSignExtendOrRandom(0x14)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariablePreSignExtendOrRandom(0x14));
             case Token::Random: // assign random forward  ?var
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariablePreSignExtendOrRandom(0x08)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariablePreSignExtendOrRandom(0x08));
             default:
                 break;
         }
@@ -77,15 +77,15 @@ public:
         const auto tk2 = m_reader.getNextToken();
         switch (tk2.type) {
             case Token::Inc: // assign post-inc
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariableIncOrDec(0x28, varInfo)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariableIncOrDec(0x28, varInfo));
             case Token::Dec: // assign post-dec
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariableIncOrDec(0x38, varInfo)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariableIncOrDec(0x38, varInfo));
             case Token::Random: // assign random reverse
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariableSideEffectOperation(0x0C, varInfo)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariableSideEffectOperation(0x0C, varInfo));
             case Token::Tilde: // assign post-clear
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariableSideEffectOperation(0x18, varInfo)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariableSideEffectOperation(0x18, varInfo));
             case Token::TildeTilde: // assign post-set
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariableSideEffectOperation(0x1C, varInfo)));
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariableSideEffectOperation(0x1C, varInfo));
             case Token::Assign:
                 return parseAssign(exprCompiler, varInfo);
             default:
@@ -97,7 +97,7 @@ public:
             // check for '=' after binary op
             const auto tk3 = m_reader.getNextToken();
             if (tk3.type == Token::Equal)
-                return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariableAssignExpression(OperatorType::Type(tk2.opType), varInfo))); //TODO operator type cast weg
+                return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariableAssignExpression(OperatorType::Type(tk2.opType), varInfo)); //TODO operator type cast weg
             m_reader.goBack(); // not '=' so backup
         }
         m_reader.goBack(); // no post-var modifier, so backup
@@ -108,7 +108,7 @@ private:
         auto sourcePosition = m_reader.getSourcePosition();
         if (!m_context.insideLoopBody)
             throw CompilerError(ErrorType::tioawarb, sourcePosition);
-        return AbstractInstructionP (new NextOrQuitInstruction(sourcePosition, isNext));
+        return AstArena::create<NextOrQuitInstruction>(sourcePosition, isNext);
     }
 
     AbstractInstructionP parseAbortOrReturn(bool isAbort) {
@@ -118,15 +118,15 @@ private:
         AbstractExpressionP returnValue;
         if (tk.type != Token::End) // there's an expression, compile it
             returnValue = ExpressionParser(m_context, true).parseExpression();
-        return AbstractInstructionP(new AbortOrReturnInstruction(tk.sourcePosition, returnValue, isAbort));
+        return AstArena::create<AbortOrReturnInstruction>(tk.sourcePosition, returnValue, isAbort);
     }
 
     AbstractInstructionP parseReboot() {
         auto sourcePosition = m_reader.getSourcePosition();
-        return AbstractInstructionP(new CallBuiltInInstruction(sourcePosition,{
-            AbstractExpressionP(new PushConstantExpression(sourcePosition, 0x80, ConstantEncoding::AutoDetect)),
-            AbstractExpressionP(new PushConstantExpression(sourcePosition, 0x00, ConstantEncoding::AutoDetect))
-        },0x20 /*clkset*/));
+        return AstArena::create<CallBuiltInInstruction>(sourcePosition,std::vector<AbstractExpressionP>{
+            AstArena::create<PushConstantExpression>(sourcePosition, 0x80, ConstantEncoding::AutoDetect),
+            AstArena::create<PushConstantExpression>(sourcePosition, 0x00, ConstantEncoding::AutoDetect)
+        },0x20 /*clkset*/);
     }
 
     AbstractInstructionP parseCogInit(ExpressionParser& exprCompiler) {
@@ -143,7 +143,7 @@ private:
             m_reader.forceElement(Token::Comma);
             auto param3 = exprCompiler.parseExpression();
             m_reader.forceElement(Token::RightBracket);
-            return AbstractInstructionP(new CogInitAsmInstruction(tk1.sourcePosition,cogIdExpression,param2,param3));
+            return AstArena::create<CogInitAsmInstruction>(tk1.sourcePosition,cogIdExpression,param2,param3);
         }
 
         // compile subroutine 'cognew' (push params+index)
@@ -151,17 +151,17 @@ private:
         m_reader.forceElement(Token::Comma);
         auto stackExpression = exprCompiler.parseExpression(); // compile stack expression
         m_reader.forceElement(Token::RightBracket);
-        return AbstractInstructionP(new CogInitSpinInstruction(tk1.sourcePosition, params, cogIdExpression, stackExpression, subSym->methodId));
+        return AstArena::create<CogInitSpinInstruction>(tk1.sourcePosition, params, cogIdExpression, stackExpression, subSym->methodId);
     }
 
     AbstractInstructionP parseUnary(ExpressionParser& exprCompiler, int value) {
-        return AbstractInstructionP(new ExpressionInstruction(exprCompiler.compileVariablePreSignExtendOrRandom(0x40 | value)));
+        return AstArena::create<ExpressionInstruction>(exprCompiler.compileVariablePreSignExtendOrRandom(0x40 | value));
     }
 
     AbstractInstructionP parseAssign(ExpressionParser& exprCompiler, AbstractSpinVariableP varInfo) {
         auto pos = m_reader.getSourcePosition();
         auto valueExpression = exprCompiler.parseExpression();
-        return AbstractInstructionP(new ExpressionInstruction(AbstractExpressionP(new AssignExpression(pos, valueExpression, varInfo, OperatorType::None))));
+        return AstArena::create<ExpressionInstruction>(AstArena::create<AssignExpression>(pos, valueExpression, varInfo, OperatorType::None));
     }
 };
 
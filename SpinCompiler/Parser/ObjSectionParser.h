@@ -16,6 +16,7 @@
 #include "SpinCompiler/Parser/ParsedObject.h"
 #include "SpinCompiler/Parser/ConstantExpressionParser.h"
 #include <algorithm>
+#include <exception>
 
 class ObjSectionParser {
 public:
@@ -24,18 +25,59 @@ private:
     TokenReader &m_reader;
     ParserObjectContext &m_objectContext;
 public:
+    //all declarations are read first, so the child objects compile in parallel
+    //they are entered in declaration order afterwards and errors are reported in the order of a serial compile
     void parseChildObjectNames(const ObjectHierarchy &hierarchy) {
-        m_reader.reset();
-        while (m_reader.getNextBlock(BlockType::BlockOBJ)) {
-            while (true) {
-                auto tk = m_reader.getNextNonBlockOrNewlineToken();
-                if (tk.eof)
-                    break;
-                if (tk.type != Token::Undefined)
-                    throw CompilerError(ErrorType::eauon, tk);
-                parseSingleChildObjectName(tk.sourcePosition, tk.symbolId, hierarchy);
+        prefetchChildObjectFiles();
+        std::vector<ChildObjectDeclaration> declarations;
+        std::exception_ptr declarationError;
+        try {
+            CompilerErrorCollector declarationErrors(m_objectContext.errors.maxErrors());
+            m_reader.reset();
+            while (m_reader.getNextBlock(BlockType::BlockOBJ)) {
+                while (true) {
+                    auto tk = m_reader.getNextNonBlockOrNewlineToken();
+                    if (tk.eof)
+                        break;
+                    const auto line = m_reader.getTokenIndex();
+                    const bool declared = declarationErrors.recover([&]() {
+                        if (tk.type != Token::Undefined)
+                            throw CompilerError(ErrorType::eauon, tk);
+                        parseSingleChildObjectName(tk.sourcePosition, tk.symbolId, hierarchy, declarations);
+                    });
+                    if (!declared) {
+                        m_reader.setTokenIndex(line);
+                        m_reader.skipLine();
+                    }
+                }
+            }
+            declarationErrors.throwIfAny();
+        }
+        catch (...) {
+            declarationError = std::current_exception();
+        }
+        //every started compile must be waited for, as it refers to hierarchy
+        std::vector<std::pair<ParsedObjectP,std::exception_ptr>> childObjects;
+        childObjects.reserve(declarations.size());
+        for (const auto& declaration:declarations) {
+            try {
+                childObjects.push_back(std::make_pair(m_objectContext.parser->compileObject(declaration.file, &hierarchy, declaration.sourcePosition), std::exception_ptr()));
+            }
+            catch (...) {
+                childObjects.push_back(std::make_pair(ParsedObjectP(), std::current_exception()));
             }
         }
+        for (int i=0; i<int(declarations.size()); ++i) {
+            m_objectContext.errors.recover([&]() {
+                if (childObjects[i].second)
+                    std::rethrow_exception(childObjects[i].second);
+                addChildObject(declarations[i], childObjects[i].first);
+            });
+        }
+        m_objectContext.errors.recover([&declarationError]() {
+            if (declarationError)
+                std::rethrow_exception(declarationError);
+        });
     }
 
     void loadChildObjects() {
@@ -44,20 +86,49 @@ public:
             if (std::find(doneObjectClasses.begin(),doneObjectClasses.end(),childObj.objectClass) != doneObjectClasses.end())
                 continue;
             doneObjectClasses.push_back(childObj.objectClass);
-            if (childObj.isUsed) {
-                for (auto m:childObj.object->methods)
-                    if (m->isPublic)
-                        m_objectContext.childObjectSymbols.addSymbol(m->symbolId, SpinAbstractSymbolP(new SpinSubSymbol(m->methodId, m->parameterCount, true)), childObj.objectClass.value());
-            }
-            for (int j=0; j<int(childObj.object->constants.size()); ++j) {
-                const auto c = childObj.object->constants[j];
-                AbstractConstantExpressionP expr = c.constantExpression->isConstant(nullptr) ? c.constantExpression : AbstractConstantExpressionP(new ChildObjConstantExpression(c.sourcePosition, childObj.objectClass, j));
-                m_objectContext.childObjectSymbols.addSymbol(c.symbolId, SpinAbstractSymbolP(new SpinConstantSymbol(expr, !c.isFloat)), childObj.objectClass.value());
-            }
+            auto exports = childObj.object->exports;
+            if (!exports) //unfinished object of a circular include, its exports are not built yet
+                exports = childObj.object->buildExports();
+            m_objectContext.childObjectSymbols.addObjectClass(childObj.objectClass, exports, childObj.isUsed);
         }
     }
 private:
-    void parseSingleChildObjectName(const SourcePosition& sourcePosition, SpinSymbolId symbolId, const ObjectHierarchy &hierarchy) {
+    struct ChildObjectDeclaration {
+        ChildObjectDeclaration(const SourcePosition& sourcePosition, SpinSymbolId symbolId, AbstractConstantExpressionP instanceCount, FileDescriptorP file):sourcePosition(sourcePosition),symbolId(symbolId),instanceCount(instanceCount),file(file) {}
+        SourcePosition sourcePosition;
+        SpinSymbolId symbolId;
+        AbstractConstantExpressionP instanceCount;
+        FileDescriptorP file;
+    };
+
+    //all child object files are known before the first one is looked up, so read them in the background
+    //errors are ignored here, they are reported in order by parseSingleChildObjectName
+    void prefetchChildObjectFiles() {
+        std::vector<std::string> fileNames;
+        m_reader.reset();
+        try {
+            while (m_reader.getNextBlock(BlockType::BlockOBJ)) {
+                while (true) {
+                    auto tk = m_reader.getNextNonBlockOrNewlineToken();
+                    if (tk.eof)
+                        break;
+                    if (tk.type != Token::Colon)
+                        continue;
+                    try {
+                        fileNames.push_back(m_reader.readFileNameString());
+                    }
+                    catch (const CompilerError&) {
+                    }
+                }
+            }
+        }
+        catch (const CompilerError&) {
+        }
+        for (const auto& fileName:fileNames)
+            m_objectContext.parser->prefetchFile(fileName, AbstractFileHandler::SpinFile);
+    }
+
+    void parseSingleChildObjectName(const SourcePosition& sourcePosition, SpinSymbolId symbolId, const ObjectHierarchy &hierarchy, std::vector<ChildObjectDeclaration>& declarations) {
         AbstractConstantExpressionP instanceCount;
         if (m_reader.checkElement(Token::LeftIndex)) { // see if there is a count
             instanceCount = ConstantExpressionParser::tryResolveValueNonAsm(m_reader, m_objectContext.childObjectSymbols, true, true).expression;
@@ -71,15 +142,19 @@ private:
 
         // now get the filename
         auto fileName = m_reader.readFileNameString();
-        auto file = m_objectContext.parser->fileHandler->findFile(fileName, AbstractFileHandler::SpinFile, FileDescriptorP(), sourcePosition);
-        auto childObj = m_objectContext.parser->compileObject(file, &hierarchy, sourcePosition);
+        auto file = m_objectContext.parser->findFile(fileName, AbstractFileHandler::SpinFile, sourcePosition);
+        m_objectContext.parser->prefetchObject(file, &hierarchy, sourcePosition);
+        declarations.push_back(ChildObjectDeclaration(sourcePosition, symbolId, instanceCount, file));
+
+        m_reader.forceElement(Token::End);
+    }
+
+    void addChildObject(const ChildObjectDeclaration& declaration, ParsedObjectP childObj) {
         // enter obj symbol
         auto objectInstanceId = m_objectContext.currentObject->reserveNextObjectInstanceId();
         const auto objectClass = m_objectContext.currentObject->reserveOrGetObjectClassId(childObj);
-        m_objectContext.globalSymbols.addSymbol(symbolId, SpinAbstractSymbolP(new SpinObjSymbol(objectClass,objectInstanceId)), 0);
-        m_objectContext.currentObject->childObjects.push_back(ParsedObject::ChildObject(sourcePosition, symbolId, instanceCount, objectInstanceId, objectClass, childObj, true));
-
-        m_reader.forceElement(Token::End);
+        m_objectContext.globalSymbols.addSymbol(declaration.symbolId, SpinAbstractSymbolP(new SpinObjSymbol(objectClass,objectInstanceId)), 0);
+        m_objectContext.currentObject->addChildObject(ParsedObject::ChildObject(declaration.sourcePosition, declaration.symbolId, declaration.instanceCount, objectInstanceId, objectClass, childObj, declaration.file->baseName(), true));
     }
 };
 
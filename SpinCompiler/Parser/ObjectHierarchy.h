@@ -18,7 +18,9 @@ struct ObjectHierarchy {
     ParsedObjectP obj;
     const ObjectHierarchy *parent;
     const SourcePosition position;
-    bool hasParent(ParsedObjectP testObj) const {
+    bool hasParent(ParsedObjectP testObj) const { //true for the object itself too
+        if (obj == testObj)
+            return true;
         if (!parent)
             return false;
         return parent->hasParent(testObj);
@@ -13,6 +13,9 @@
 
 #include "SpinCompiler/Types/ConstantExpression.h"
 #include "SpinCompiler/Types/DatCodeEntry.h"
+#include "SpinCompiler/Tokenizer/SymbolMap.h"
+#include "SpinCompiler/Parser/ChildObjectSymbols.h"
+#include <map>
 
 
 typedef std::shared_ptr<class AbstractInstruction> AbstractInstructionP;
@@ -36,22 +39,26 @@ public:
         AbstractConstantExpressionP count;
     };
     struct Method {
-        Method():parameterCount(0),isPublic(false) {}
-        Method(const SourcePosition &sourcePosition, SpinSymbolId symbolId, MethodId methodId, int parameterCount, const std::vector<ParsedObject::LocalVar>& allLocals, bool isPublic):sourcePosition(sourcePosition),symbolId(symbolId),methodId(methodId),parameterCount(parameterCount),allLocals(allLocals),isPublic(isPublic) {}
+        Method():parameterCount(0),isPublic(false),mayStartCog(false) {}
+        Method(const SourcePosition &sourcePosition, SpinSymbolId symbolId, MethodId methodId, int parameterCount, const std::vector<ParsedObject::LocalVar>& allLocals, bool isPublic):sourcePosition(sourcePosition),symbolId(symbolId),methodId(methodId),parameterCount(parameterCount),allLocals(allLocals),isPublic(isPublic),mayStartCog(false) {}
         SourcePosition sourcePosition;
+        AstArenaP bodyArena; //nodes of functionBody, declared first as it must outlive them
         AbstractInstructionP functionBody;
         SpinSymbolId symbolId;
         MethodId methodId;
         int parameterCount;
         std::vector<ParsedObject::LocalVar> allLocals;
         bool isPublic;
+        TokenIndex bodyTokenIndex; //start of the body, see PubPriSectionParser::recordSubBlocks
+        bool mayStartCog; //body not parsed yet contains COGNEW or COGINIT
     };
     typedef std::shared_ptr<Method> MethodP;
     struct ChildObject {
         ChildObject():numberOfInstances(0),objectClass(-1),isUsed(false) {}
-        ChildObject(const SourcePosition& sourcePosition, SpinSymbolId symbolId, AbstractConstantExpressionP numberOfInstances, ObjectInstanceId objectInstanceId, ObjectClassId objectClass, ParsedObjectP object, bool isUsed):sourcePosition(sourcePosition),object(object),numberOfInstances(numberOfInstances),objectInstanceId(objectInstanceId),symbolId(symbolId),objectClass(objectClass),isUsed(isUsed) {}
+        ChildObject(const SourcePosition& sourcePosition, SpinSymbolId symbolId, AbstractConstantExpressionP numberOfInstances, ObjectInstanceId objectInstanceId, ObjectClassId objectClass, ParsedObjectP object, const std::string& shortName, bool isUsed):sourcePosition(sourcePosition),object(object),shortName(shortName),numberOfInstances(numberOfInstances),objectInstanceId(objectInstanceId),symbolId(symbolId),objectClass(objectClass),isUsed(isUsed) {}
         SourcePosition sourcePosition;
         ParsedObjectP object;
+        std::string shortName; //of the included file, files with the same content share one object
         AbstractConstantExpressionP numberOfInstances;
         ObjectInstanceId objectInstanceId;
         SpinSymbolId symbolId;
@@ -63,9 +70,9 @@ public:
         return ObjectInstanceId(m_nextObjectInstanceId++);
     }
     ObjectClassId reserveOrGetObjectClassId(ParsedObjectP obj) {
-        for (const auto& c:childObjects)
-            if (c.object == obj)
-                return c.objectClass;
+        auto it = m_objectClassByObject.find(obj.get());
+        if (it != m_objectClassByObject.end())
+            return it->second;
         return ObjectClassId(m_nextObjectClassId++);
     }
     MethodId reserveNextMethodId() {
@@ -77,23 +84,68 @@ public:
     VarSymbolId reserveNextVarSymbolId() {
         return VarSymbolId(m_nextVarSymbolId++);
     }
+    //all ids reserved so far are below these limits, generators size their tables by them
+    int objectInstanceIdLimit() const { return m_nextObjectInstanceId; }
+    int objectClassIdLimit() const { return m_nextObjectClassId; }
+    int datSymbolIdLimit() const { return m_nextDatSymbolId; }
+    int varSymbolIdLimit() const { return m_nextVarSymbolId; }
     const ChildObject& childObjectByObjectInstanceId(ObjectInstanceId objectInstanceId) const {
-        for (const auto& ch:childObjects)
-            if (ch.objectInstanceId == objectInstanceId)
-                return ch;
-        throw CompilerError(ErrorType::internal);
+        const int index = denseIndex(m_childObjectIndexByInstanceId, objectInstanceId.value());
+        if (index < 0)
+            throw CompilerError(ErrorType::internal);
+        return childObjects[index];
     }
     int methodIndexById(MethodId methodId) const {
-        for (int i=0; i<int(methods.size()); ++i)
-            if (methods[i]->methodId == methodId)
-                return i;
-        throw CompilerError(ErrorType::internal);
+        const int index = denseIndex(m_methodIndexById, methodId.value());
+        if (index < 0)
+            throw CompilerError(ErrorType::internal);
+        return index;
     }
     int indexOfConstantIfAvailable(SpinSymbolId symbolId) const {
-        for (unsigned i=0; i<constants.size(); ++i)
-            if (constants[i].symbolId == symbolId)
-                return int(i);
-        return -1;
+        auto it = m_constantIndexBySymbol.find(symbolId);
+        return it != m_constantIndexBySymbol.end() ? it->second : -1;
+    }
+
+    //constants, methods and child objects are only added by these functions, they keep the lookup indices up to date
+    void addConstant(const Constant& constant) {
+        m_constantIndexBySymbol.insert(std::make_pair(constant.symbolId, int(constants.size())));
+        constants.push_back(constant);
+    }
+    void addMethod(MethodP method) {
+        setDenseIndex(m_methodIndexById, method->methodId.value(), int(methods.size()));
+        methods.push_back(method);
+    }
+    void setMethods(const std::vector<MethodP>& newMethods) { //keeps the method ids, but not the indices
+        methods = newMethods;
+        m_methodIndexById.clear();
+        for (int i=0; i<int(methods.size()); ++i)
+            setDenseIndex(m_methodIndexById, methods[i]->methodId.value(), i);
+    }
+    void addChildObject(const ChildObject& childObject) {
+        setDenseIndex(m_childObjectIndexByInstanceId, childObject.objectInstanceId.value(), int(childObjects.size()));
+        m_objectClassByObject.insert(std::make_pair(childObject.object.get(), childObject.objectClass));
+        childObjects.push_back(childObject);
+    }
+
+    //pub methods and constants as seen by the parent objects, all parents share them
+    //constants which are not constant before generation refer to the object class the parent gives this object, it is left invalid here
+    ObjectExportsP buildExports() const {
+        std::shared_ptr<SymbolMap> symbols(new SymbolMap());
+        std::shared_ptr<ObjectExports> result(new ObjectExports());
+        for (auto m:methods)
+            if (m->isPublic)
+                symbols->addSymbol(m->symbolId, SpinAbstractSymbolP(new SpinSubSymbol(m->methodId, m->parameterCount, true)), 0);
+        for (int j=0; j<int(constants.size()); ++j) {
+            const auto& c = constants[j];
+            AbstractConstantExpressionP expr = c.constantExpression;
+            if (!expr->isConstant(nullptr)) {
+                expr = AstArena::create<ChildObjConstantExpression>(c.sourcePosition, ObjectClassId(), j);
+                result->unboundConstants.push_back(ObjectExports::UnboundConstant(c.symbolId, c.sourcePosition, j, !c.isFloat));
+            }
+            symbols->addSymbol(c.symbolId, SpinAbstractSymbolP(new SpinConstantSymbol(expr, !c.isFloat)), 0);
+        }
+        result->symbols = symbols;
+        return result;
     }
 
     explicit ParsedObject(const std::string &shortName):shortName(shortName),m_nextObjectClassId(1),m_nextObjectInstanceId(1),m_nextMethodId(1),m_nextDatSymbolId(1),m_nextVarSymbolId(1) {}
@@ -102,6 +154,11 @@ public:
         methods.clear();
         globalVariables.clear();
         childObjects.clear();
+        m_constantIndexBySymbol.clear();
+        m_methodIndexById.clear();
+        m_childObjectIndexByInstanceId.clear();
+        m_objectClassByObject.clear();
+        exports.reset();
         m_nextObjectClassId = 1;
         m_nextObjectInstanceId = 1;
         m_nextMethodId = 1;
@@ -118,12 +175,27 @@ public:
     std::vector<ChildObject> childObjects;
     std::vector<DatCodeEntry> datCode;
     std::vector<SpinVarSectionSymbolP> globalVariables;
+    ObjectExportsP exports; //built by the parser once the object is parsed
 private:
     int m_nextObjectClassId;
     int m_nextObjectInstanceId;
     int m_nextMethodId;
     int m_nextDatSymbolId;
     int m_nextVarSymbolId;
+    std::map<SpinSymbolId,int> m_constantIndexBySymbol;
+    std::vector<int> m_methodIndexById; //ids are reserved one by one, so they index a vector, -1 for unused ids
+    std::vector<int> m_childObjectIndexByInstanceId;
+    std::map<const ParsedObject*,ObjectClassId> m_objectClassByObject;
+
+    static int denseIndex(const std::vector<int>& index, int id) {
+        return id >= 0 && id < int(index.size()) ? index[id] : -1;
+    }
+    static void setDenseIndex(std::vector<int>& index, int id, int value) {
+        if (id >= int(index.size()))
+            index.resize(id+1, -1);
+        if (index[id] < 0) //first entry wins like the linear search did
+            index[id] = value;
+    }
 };
 
 #endif //SPINCOMPILER_PARSEDOBJECT_H
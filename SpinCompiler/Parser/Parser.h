@@ -21,40 +21,227 @@
 #include "SpinCompiler/Tokenizer/Tokenizer.h"
 #include "SpinCompiler/Tokenizer/MacroPreProcessor.h"
 #include "SpinCompiler/Types/CompilerSettings.h"
+#include "SpinCompiler/Types/ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <set>
 
 class Parser : public AbstractParser {
 public:
-    explicit Parser(AbstractFileHandler *fileHandler, const CompilerSettings& settings):AbstractParser(fileHandler),m_settings(settings) {}
+    explicit Parser(AbstractFileHandler *fileHandler, const CompilerSettings& settings):AbstractParser(fileHandler),m_settings(settings),m_macroEnvironmentHash(macroEnvironmentHash(settings)) {}
     virtual ~Parser() {}
     virtual ParsedObjectP compileObject(FileDescriptorP file, const ObjectHierarchy *hierarchy, const SourcePosition& includePos) {
-        auto found = m_objectMap.find(file.get());
-        if (found != m_objectMap.end()) {
-            if (hierarchy && hierarchy->hasParent(found->second))
-                throw CompilerError(ErrorType::circ,hierarchy->position);
-            return found->second;
+        ObjectTaskP task;
+        ObjectTask *requester = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_objectMutex);
+            auto found = m_objectMap.find(file.get());
+            task = found != m_objectMap.end() ? found->second : findObjectTaskBySource(file);
+            //also for an object shared with another file of the same content, before it is reused
+            if (task && hierarchy && hierarchy->hasParent(task->obj))
+                throw CompilerError(ErrorType::circ,includePos);
+            if (!task)
+                task = addObjectTask(file, hierarchy, includePos);
+            m_objectMap[file.get()] = task;
+            if (hierarchy) {
+                requester = m_objectTasks[hierarchy->obj.get()];
+                //circular include, the object is waiting for the requesting one: return it unfinished like a serial compile would
+                for (auto waiting = task.get(); waiting; waiting = waiting->waitingFor)
+                    if (waiting == requester)
+                        return task->obj;
+                requester->waitingFor = task.get();
+            }
         }
-
-        ParsedObjectP newObj(new ParsedObject(file->baseName()));
-        ObjectHierarchy childHierarchy(newObj, hierarchy, includePos);
-        m_objectMap[file.get()] = newObj;
-        compile(file, childHierarchy);
-        return newObj;
+        runObjectTask(*task); //compile inline, unless a worker has already started it
+        task->done.wait();
+        if (requester) {
+            std::lock_guard<std::mutex> lock(m_objectMutex);
+            requester->waitingFor = nullptr;
+        }
+        rethrowErrors(*task, file);
+        return task->obj;
+    }
+    virtual void prefetchObject(FileDescriptorP file, const ObjectHierarchy *hierarchy, const SourcePosition& includePos) {
+        ObjectTaskP task;
+        {
+            std::lock_guard<std::mutex> lock(m_objectMutex);
+            if (m_objectMap.find(file.get()) != m_objectMap.end() || findObjectTaskBySource(file)) //same source known under another name is registered by compileObject
+                return;
+            task = addObjectTask(file, hierarchy, includePos);
+            m_objectMap[file.get()] = task;
+        }
+        m_objectWorkers.submit([this, task]() { runObjectTask(*task); });
+    }
+    virtual void parseMethodBody(ParsedObject* object, ParsedObject::MethodP method) {
+        if (method->functionBody || m_settings.compileDatOnly) //bodies are not recorded for DAT only output, elimination sees them empty
+            return;
+        auto source = m_objectSources.find(object);
+        if (source == m_objectSources.end() || !method->bodyTokenIndex.valid())
+            throw CompilerError(ErrorType::internal, method->sourcePosition);
+        AstArena::Scope astScope(astArena);
+        CompilerErrorCollector errors(m_settings.maxErrors);
+        PubPriSectionParser(source->second->reader, source->second->objContext).parseSubBody(method, errors);
+        errors.throwIfAny();
+    }
+    //tokens and symbol maps of the objects, kept for lazily parsed method bodies only
+    void releaseObjectSources() {
+        std::lock_guard<std::mutex> lock(m_objectMutex);
+        m_objectSources.clear();
     }
     std::vector<ParsedObjectP> listAllObjects(ParsedObjectP root) const {
         std::vector<ParsedObjectP> result;
         result.reserve(m_objectMap.size());
         result.push_back(root);
+        std::set<ParsedObject*> listed;
+        listed.insert(root.get());
         for (auto it:m_objectMap)
-            if (it.second != root)
-                result.push_back(it.second);
+            if (listed.insert(it.second->obj.get()).second) //files with the same content share one object
+                result.push_back(it.second->obj);
         return result;
     }
 private:
-    std::map<FileDescriptor*, ParsedObjectP> m_objectMap;
+    //tokens and symbols of an object, kept as long as method bodies may be parsed lazily
+    struct ObjectSource {
+        ObjectSource(AbstractParser *parser, ParsedObjectP obj, int maxErrors, TokenList&& tokenList):objContext(parser,obj,maxErrors),tokenList(std::move(tokenList)),reader(this->tokenList,objContext.globalSymbols) {}
+        ParserObjectContext objContext;
+        TokenList tokenList;
+        TokenReader reader;
+    };
+
+    //compile of a single object, runs on a worker or inline on the first thread waiting for it
+    struct ObjectTask {
+        ObjectTask(ParsedObjectP obj, FileDescriptorP file, const ObjectHierarchy *parent, const SourcePosition& includePos):obj(obj),file(file),parent(parent),includePos(includePos),started(false),waitingFor(nullptr),done(promise.get_future().share()) {}
+        ParsedObjectP obj;
+        FileDescriptorP file;
+        const ObjectHierarchy *parent;
+        SourcePosition includePos;
+        std::atomic<bool> started;
+        ObjectTask *waitingFor; //child object this one is blocked on, used to detect circular includes
+        std::promise<void> promise;
+        std::shared_future<void> done;
+    };
+    typedef std::shared_ptr<ObjectTask> ObjectTaskP;
+
+    //objects are identified by source content, so copies of a file reached by different names are parsed once
+    struct SourceKey {
+        SourceKey(uint64_t contentHash, uint64_t macroEnvironmentHash):contentHash(contentHash),macroEnvironmentHash(macroEnvironmentHash) {}
+        uint64_t contentHash;
+        uint64_t macroEnvironmentHash;
+        bool operator<(const SourceKey& other) const {
+            return contentHash != other.contentHash ? contentHash < other.contentHash : macroEnvironmentHash < other.macroEnvironmentHash;
+        }
+    };
+
+    std::mutex m_objectMutex; //guards m_objectMap, m_objectsBySource, m_objectTasks, m_objectSources and ObjectTask::waitingFor
+    std::map<FileDescriptor*, ObjectTaskP> m_objectMap;
+    std::map<SourceKey, std::vector<ObjectTaskP>> m_objectsBySource; //several tasks only on hash collisions
+    std::map<ParsedObject*, ObjectTask*> m_objectTasks;
+    std::map<ParsedObject*, std::unique_ptr<ObjectSource>> m_objectSources;
     const CompilerSettings &m_settings;
+    const uint64_t m_macroEnvironmentHash; //every object starts preprocessing with the predefined macros
+    ThreadPool m_workers;
+    ThreadPool m_objectWorkers; //tasks may block on child objects, so they do not share m_workers
+
+    static uint64_t hashBytes(uint64_t hash, const unsigned char *data, size_t size) { //FNV-1a
+        for (size_t i=0; i<size; ++i)
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        return hash;
+    }
+    static uint64_t hashString(uint64_t hash, const std::string& str) {
+        hash = hashBytes(hash, reinterpret_cast<const unsigned char*>(str.data()), str.size());
+        return hashBytes(hash, reinterpret_cast<const unsigned char*>(""), 1); //terminator, so "a","bc" differs from "ab","c"
+    }
+    static uint64_t macroEnvironmentHash(const CompilerSettings& settings) {
+        uint64_t hash = 14695981039346656037ull;
+        if (!settings.usePreProcessor)
+            return hash;
+        for (const auto& macro:settings.preDefinedMacros)
+            hash = hashString(hashString(hash, macro.first), macro.second);
+        return hash+1;
+    }
+
+    SourceKey sourceKey(FileDescriptorP file) const {
+        return SourceKey(hashBytes(14695981039346656037ull, file->content.data(), file->content.size()), m_macroEnvironmentHash);
+    }
+
+    //task of another file with the same content, nullptr if there is none, must be called with m_objectMutex locked
+    ObjectTaskP findObjectTaskBySource(FileDescriptorP file) {
+        auto candidates = m_objectsBySource.find(sourceKey(file));
+        if (candidates == m_objectsBySource.end())
+            return ObjectTaskP();
+        for (const auto& task:candidates->second) {
+            if (task->file->content != file->content)
+                continue;
+            //the shared object is named after the smallest file name, independent of which file was reached first
+            if (file->baseName() < task->obj->shortName)
+                task->obj->shortName = file->baseName();
+            return task;
+        }
+        return ObjectTaskP();
+    }
+
+    //must be called with m_objectMutex locked and no task for the source of file
+    ObjectTaskP addObjectTask(FileDescriptorP file, const ObjectHierarchy *hierarchy, const SourcePosition& includePos) {
+        ObjectTaskP task(new ObjectTask(ParsedObjectP(new ParsedObject(file->baseName())), file, hierarchy, includePos));
+        m_objectTasks[task->obj.get()] = task.get();
+        m_objectsBySource[sourceKey(file)].push_back(task);
+        return task;
+    }
+
+    //errors of an object shared by several files name the file it was requested by
+    static void rethrowErrors(const ObjectTask& task, FileDescriptorP file) {
+        try {
+            task.done.get();
+        }
+        catch (const CompilerError& e) {
+            if (task.file == file)
+                throw;
+            throw errorInFile(e, task.file, file);
+        }
+        catch (const CompilerErrorList& list) {
+            if (task.file == file)
+                throw;
+            CompilerErrorList result(list);
+            for (auto& e:result.errors)
+                e = errorInFile(e, task.file, file);
+            throw result;
+        }
+    }
+    static CompilerError errorInFile(const CompilerError& e, FileDescriptorP sharedFile, FileDescriptorP file) {
+        CompilerError result(e);
+        if (result.sourcePosition.file.file == sharedFile)
+            result.sourcePosition.file.file = file;
+        return result;
+    }
+
+    void runObjectTask(ObjectTask& task) {
+        if (task.started.exchange(true))
+            return;
+        AstArena::Scope astScope(astArena);
+        try {
+            ObjectHierarchy hierarchy(task.obj, task.parent, task.includePos);
+            compile(task.file, hierarchy);
+            task.promise.set_value();
+        }
+        catch (...) {
+            task.promise.set_exception(std::current_exception());
+        }
+    }
 
 
     void compile(FileDescriptorP file, const ObjectHierarchy &hierarchy) {
+        std::unique_ptr<ObjectSource> source(new ObjectSource(this,hierarchy.obj,m_settings.maxErrors,tokenize(file)));
+        compileStep1(source->reader,source->objContext,hierarchy);
+        compileStep2(source->reader,source->objContext);
+        hierarchy.obj->exports = hierarchy.obj->buildExports();
+        if (parseMethodBodiesLazily()) {
+            std::lock_guard<std::mutex> lock(m_objectMutex);
+            m_objectSources[hierarchy.obj.get()] = std::move(source);
+        }
+    }
+
+    //the converted and preprocessed source text only lives until its tokens are read
+    TokenList tokenize(FileDescriptorP file) {
         std::string preProcessorIn;
         CharsetConverter charsetConverter(file->content,preProcessorIn);
         charsetConverter.convert();
@@ -66,31 +253,42 @@ private:
             preProcessor.runFile();
         }
         else
-            sourceCode = preProcessorIn;
+            sourceCode.swap(preProcessorIn);
+        std::string().swap(preProcessorIn);
+        return Tokenizer::readTokenList(builtInSymbols, sourceCode,srcPosFile,m_workers);
+    }
 
-        ParserObjectContext objContext(this,hierarchy.obj);
-        auto tokenList = Tokenizer::readTokenList(builtInSymbols, sourceCode,srcPosFile);
-        TokenReader reader(tokenList,objContext.globalSymbols);
-        compileStep1(reader,objContext,hierarchy);
-        compileStep2(reader,objContext);
+    //with unused method elimination only the bodies of reachable methods need to be parsed
+    bool parseMethodBodiesLazily() const {
+        return m_settings.unusedMethodOptimization != CompilerSettings::UnusedMethods::Keep && !m_settings.strictMode && m_settings.annotatedOutput != CompilerSettings::AnnotatedOutput::AST;
     }
 
     void compileStep1(TokenReader& reader, ParserObjectContext& objContext, const ObjectHierarchy &hierarchy) {
         objContext.currentObject->clear();
         objContext.globalSymbols = SymbolMap(); //delete all Symbols
         ConSectionParser(reader, objContext).parseDevBlocks();
-        ConSectionParser(reader, objContext).parseConBlocks(0);
+        ConSectionParser(reader, objContext).parseConBlocks();
+        objContext.errors.throwIfAny();
         PubPriSectionParser(reader, objContext).parseSubSymbols(m_settings.defaultCompileMode);
+        objContext.errors.throwIfAny();
         ObjSectionParser(reader, objContext).parseChildObjectNames(hierarchy);
+        objContext.errors.throwIfAny();
     }
 
     void compileStep2(class TokenReader &reader, ParserObjectContext& objContext) {
         ObjSectionParser(reader, objContext).loadChildObjects();
-        ConSectionParser(reader, objContext).parseConBlocks(1);
+        ConSectionParser(reader, objContext).resolvePendingConstants();
+        objContext.errors.throwIfAny();
         VarSectionParser(reader, objContext).parseVarBlocks();
         DatSectionParser(reader, objContext).parseDatBlocks();
-        if (!m_settings.compileDatOnly)
-            PubPriSectionParser(reader, objContext).parseSubBlocks();
+        objContext.errors.throwIfAny();
+        if (!m_settings.compileDatOnly) {
+            PubPriSectionParser subParser(reader, objContext);
+            subParser.recordSubBlocks();
+            if (!parseMethodBodiesLazily())
+                subParser.parseSubBodies(m_workers);
+            objContext.errors.throwIfAny();
+        }
     }
 };
 
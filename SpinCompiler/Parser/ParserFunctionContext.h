@@ -18,11 +18,12 @@ struct ParserObjectContext;
 struct ParserFunctionContext {
     TokenReader &reader;
     ParserObjectContext &objectContext;
+    CompilerErrorCollector &errors; //errors of the method, bodies may be parsed in parallel
     int &stringsCounter;
     const bool insideLoopBody;
-    explicit ParserFunctionContext(TokenReader &reader, ParserObjectContext& objectContext, bool insideLoopBody, int &stringsCounter):reader(reader),objectContext(objectContext),stringsCounter(stringsCounter),insideLoopBody(insideLoopBody) {}
+    explicit ParserFunctionContext(TokenReader &reader, ParserObjectContext& objectContext, CompilerErrorCollector &errors, bool insideLoopBody, int &stringsCounter):reader(reader),objectContext(objectContext),errors(errors),stringsCounter(stringsCounter),insideLoopBody(insideLoopBody) {}
     ParserFunctionContext contextNewLoop() const {
-        return ParserFunctionContext(reader,objectContext,true,stringsCounter);
+        return ParserFunctionContext(reader,objectContext,errors,true,stringsCounter);
     }
 };
 
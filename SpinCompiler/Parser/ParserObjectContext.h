@@ -13,29 +13,51 @@
 
 #include "SpinCompiler/Types/Token.h"
 #include "SpinCompiler/Types/CompilerError.h"
+#include "SpinCompiler/Types/ConstantExpression.h"
 #include "SpinCompiler/Tokenizer/SymbolMap.h"
+#include "SpinCompiler/Parser/ChildObjectSymbols.h"
 
 typedef std::shared_ptr<class ParsedObject> ParsedObjectP;
 class AbstractParser;
 
+//con definition which could not be resolved while reading the con blocks, resolved by ConSectionParser in dependency order
+struct PendingConstant {
+    enum Type { Assignment, Enumeration, EnumerationStart };
+    enum State { Unresolved, Resolving, Resolved, Failed };
+    PendingConstant(Type type, SpinSymbolId symbolId, const SourcePosition& namePosition, const SourcePosition& sourcePosition, TokenIndex expression):
+        type(type),symbolId(symbolId),namePosition(namePosition),sourcePosition(sourcePosition),expression(expression),previous(-1),state(Unresolved) {}
+    Type type;
+    SpinSymbolId symbolId; //invalid for EnumerationStart
+    SourcePosition namePosition;
+    SourcePosition sourcePosition;
+    TokenIndex expression; //value, enumeration step or start, invalid if enumerated by 1
+    AbstractConstantExpressionP enumValue; //Enumeration: enum value before this definition if previous<0, afterwards: enum value behind this definition
+    int previous; //Enumeration: index of the pending definition holding the enum value before this definition
+    std::vector<std::pair<SpinSymbolId,SourcePosition>> dependencies; //all undefined symbols used by the expression
+    State state;
+};
+
 struct ParserObjectContext {
-    explicit ParserObjectContext(AbstractParser *parser, ParsedObjectP currentObject):
+    explicit ParserObjectContext(AbstractParser *parser, ParsedObjectP currentObject, int maxErrors):
         parser(parser),
-        currentObject(currentObject) {}
+        currentObject(currentObject),
+        errors(maxErrors) {}
     AbstractParser *parser;
     ParsedObjectP currentObject;
-    SymbolMap childObjectSymbols; //con and pub of child objects
+    CompilerErrorCollector errors;
+    ChildObjectSymbols childObjectSymbols; //con and pub of child objects
     SymbolMap globalSymbols; //con, pub, pri, var, dat of this object
+    std::vector<PendingConstant> pendingConstants;
 
     std::shared_ptr<SpinSubSymbol> getObjMethod(const Token& tkin, ObjectClassId objClass) {
-        if (auto ptr = childObjectSymbols.hasSpecificSymbol<SpinSubSymbol>(tkin.symbolId, objClass.value()))
+        if (auto ptr = childObjectSymbols.hasMethod(tkin.symbolId, objClass))
             return ptr;
         throw CompilerError(ErrorType::easn, tkin);
     }
 
     std::shared_ptr<SpinConstantSymbol> getObjConstant(const Token& tkin, ObjectClassId objClass) {
         if (tkin.symbolId.valid()) { //nur echte symbole
-            if (auto conSym = childObjectSymbols.hasSpecificSymbol<SpinConstantSymbol>(tkin.symbolId, objClass.value()))
+            if (auto conSym = childObjectSymbols.hasConstant(tkin.symbolId, objClass))
                 return conSym;
         }
         throw CompilerError(ErrorType::eacn, tkin);
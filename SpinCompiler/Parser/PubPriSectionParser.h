@@ -13,6 +13,7 @@
 
 #include "SpinCompiler/Parser/InstructionBlockParser.h"
 #include "SpinCompiler/Parser/ParsedObject.h"
+#include "SpinCompiler/Types/ThreadPool.h"
 
 class PubPriSectionParser {
 public:
@@ -24,16 +25,51 @@ public:
     // This function parses all sub (PUB/PRI) names as symbol and skips the sub body
     void parseSubSymbols(bool forceAtLeastOnePubMethod) {
         parseSubSymbolsOfType(BlockType::BlockPUB);
-        if (m_objectContext.currentObject->methods.empty() && forceAtLeastOnePubMethod)
+        if (m_objectContext.currentObject->methods.empty() && forceAtLeastOnePubMethod && !m_objectContext.errors.hasErrors())
             throw CompilerError(ErrorType::nprf,m_reader.getSourcePosition());
         parseSubSymbolsOfType(BlockType::BlockPRI);
     }
 
-    // This function parses the actual sub (PUB/PRI) body
-    void parseSubBlocks() {
+    // This function records where the actual sub (PUB/PRI) bodies start
+    void recordSubBlocks() {
         int subCount = 0;
-        parseSubBlocksOfType(BlockType::BlockPUB, subCount);
-        parseSubBlocksOfType(BlockType::BlockPRI, subCount);
+        recordSubBlocksOfType(BlockType::BlockPUB, subCount);
+        recordSubBlocksOfType(BlockType::BlockPRI, subCount);
+    }
+
+    // This function parses all bodies recorded by recordSubBlocks in parallel
+    // the symbol tables and the token list are only read now, each body gets its own reader and error collector
+    void parseSubBodies(ThreadPool& pool) {
+        const auto& methods = m_objectContext.currentObject->methods;
+        if (methods.size() < 2) {
+            for (auto method:methods)
+                parseSubBody(method, m_objectContext.errors);
+            return;
+        }
+        const int maxErrors = m_objectContext.errors.maxErrors();
+        std::vector<std::future<void>> results;
+        results.reserve(methods.size());
+        for (auto method:methods) {
+            results.push_back(pool.submit([this, method, maxErrors]() {
+                TokenReader reader(m_reader);
+                CompilerErrorCollector errors(maxErrors);
+                PubPriSectionParser(reader, m_objectContext).parseSubBody(method, errors);
+                errors.throwIfAny();
+            }));
+        }
+        // wait for all bodies before collecting, then report the errors in method order like parsing them one by one would do
+        for (auto& result:results)
+            result.wait();
+        for (auto& result:results)
+            m_objectContext.errors.recover([&result]() { result.get(); });
+    }
+
+    // This function parses a body recorded by recordSubBlocks
+    void parseSubBody(ParsedObject::MethodP method, CompilerErrorCollector &errors) {
+        method->bodyArena = AstArenaP(new AstArena(AstArena::MethodChunkSize));
+        AstArena::Scope astScope(method->bodyArena); //released together with the body after byte code generation
+        m_reader.setTokenIndex(method->bodyTokenIndex);
+        parseSub(method, errors);
     }
 private:
     void skipParameters() {
@@ -65,14 +101,10 @@ private:
         }
     }
 
-    void parseSub(const int subCount) {
+    void parseSub(ParsedObject::MethodP method, CompilerErrorCollector &errors) {
         SymbolMap localSymbols;
         m_reader.setupLocalSymbolMap(&localSymbols);
         auto methodSymbolId = m_reader.getNextToken().symbolId; //method name
-
-        if (subCount>=int(m_objectContext.currentObject->methods.size()))
-            throw CompilerError(ErrorType::internal, m_reader.getSourcePosition());
-        auto method = m_objectContext.currentObject->methods[subCount];
         if (method->symbolId != methodSymbolId)
             throw CompilerError(ErrorType::internal, m_reader.getSourcePosition());
 
@@ -84,14 +116,29 @@ private:
         skipParameters();
         skipResult();
         skipLocals();
-        method->functionBody = InstructionBlockParser::compileFunction(m_reader, m_objectContext); // instruction block compiler
+        method->functionBody = InstructionBlockParser::compileFunction(m_reader, m_objectContext, errors); // instruction block compiler
         m_reader.setupLocalSymbolMap(nullptr); // cancel local symbols
     }
 
-    void parseSubBlocksOfType(BlockType::Type blockType, int &subCount) {
+    void recordSub(ParsedObject::MethodP method) {
+        method->bodyTokenIndex = m_reader.getTokenIndex();
+        while (true) {
+            auto tk = m_reader.getNextToken();
+            if (tk.eof || tk.type == Token::Block)
+                break;
+            if (tk.type == Token::CogNew || tk.type == Token::CogInit)
+                method->mayStartCog = true;
+        }
+        m_reader.setTokenIndex(method->bodyTokenIndex);
+    }
+
+    void recordSubBlocksOfType(BlockType::Type blockType, int &subCount) {
         m_reader.reset();
-        while (m_reader.getNextBlock(blockType))
-            parseSub(subCount++);
+        while (m_reader.getNextBlock(blockType)) {
+            if (subCount>=int(m_objectContext.currentObject->methods.size()))
+                throw CompilerError(ErrorType::internal, m_reader.getSourcePosition());
+            recordSub(m_objectContext.currentObject->methods[subCount++]);
+        }
     }
 
     void parseParameters(std::vector<ParsedObject::LocalVar>& result) {
@@ -145,22 +192,25 @@ private:
 
     void parseSubSymbolsOfType(const BlockType::Type blockType) {
         m_reader.reset();
-        while (m_reader.getNextBlock(blockType)) {
-            auto sourcePosition = m_reader.getSourcePosition();
-            const MethodId methodId = m_objectContext.currentObject->reserveNextMethodId();
-            std::vector<ParsedObject::LocalVar> allLocals;
-            //reserve on stack space for result value (always present)
-            allLocals.push_back(ParsedObject::LocalVar(sourcePosition, SpinSymbolId(), LocSymbolId(0), ConstantValueExpression::create(sourcePosition,1)));
-            auto symbolId = m_reader.forceUnusedSymbol(ErrorType::eausn).symbolId; //name of method
-            parseParameters(allLocals);
-            const int parameterCount = int(allLocals.size())-1; //1 result value subtracted to get parameter count
-            parseResult(allLocals[0]);
-            parseLocals(allLocals);
-
-
-            m_objectContext.globalSymbols.addSymbol(symbolId, SpinAbstractSymbolP(new SpinSubSymbol(methodId, parameterCount, blockType == BlockType::BlockPUB)), 0);
-            m_objectContext.currentObject->methods.push_back(ParsedObject::MethodP(new ParsedObject::Method(sourcePosition, symbolId, methodId, parameterCount, allLocals, blockType == BlockType::BlockPUB)));
-        }
+        while (m_reader.getNextBlock(blockType))
+            m_objectContext.errors.recover([this, blockType]() { parseSubSymbol(blockType); });
+    }
+
+    void parseSubSymbol(const BlockType::Type blockType) {
+        auto sourcePosition = m_reader.getSourcePosition();
+        const MethodId methodId = m_objectContext.currentObject->reserveNextMethodId();
+        std::vector<ParsedObject::LocalVar> allLocals;
+        //reserve on stack space for result value (always present)
+        allLocals.push_back(ParsedObject::LocalVar(sourcePosition, SpinSymbolId(), LocSymbolId(0), ConstantValueExpression::create(sourcePosition,1)));
+        auto symbolId = m_reader.forceUnusedSymbol(ErrorType::eausn).symbolId; //name of method
+        parseParameters(allLocals);
+        const int parameterCount = int(allLocals.size())-1; //1 result value subtracted to get parameter count
+        parseResult(allLocals[0]);
+        parseLocals(allLocals);
+
+
+        m_objectContext.globalSymbols.addSymbol(symbolId, SpinAbstractSymbolP(new SpinSubSymbol(methodId, parameterCount, blockType == BlockType::BlockPUB)), 0);
+        m_objectContext.currentObject->addMethod(ParsedObject::MethodP(new ParsedObject::Method(sourcePosition, symbolId, methodId, parameterCount, allLocals, blockType == BlockType::BlockPUB)));
     }
 };
 
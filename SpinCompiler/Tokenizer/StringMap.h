@@ -15,16 +15,20 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <mutex>
 
+// shared by all objects, which may be tokenized on different threads
 class StringMap {
 public:
     SpinSymbolId hasSymbolName(const std::string& str) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto it = m_map.find(str);
         if (it == m_map.end())
             return SpinSymbolId(-1);
         return it->second;
     }
     SpinSymbolId getOrPutSymbolName(const std::string& str) {
+        std::lock_guard<std::mutex> lock(m_mutex);
         auto &res = m_map[str];
         if (!res.valid()) {
             res = SpinSymbolId(m_entries.size());
@@ -33,11 +37,13 @@ public:
         return res;
     }
     std::string getNameBySymbolId(SpinSymbolId id) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
         return id.valid() ? m_entries[id.value()] : std::string();
     }
 private:
     std::map<std::string, SpinSymbolId> m_map;
     std::vector<std::string> m_entries;
+    mutable std::mutex m_mutex;
 };
 
 #endif //SPINCOMPILER_STRINGMAP_H
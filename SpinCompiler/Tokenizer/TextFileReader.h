@@ -20,7 +20,7 @@ private:
     const std::string& m_sourceCode;
     int m_sourceIndex;
 public:
-    TextFileReader(const std::string& sourceCode, SourcePositionFile file):m_currentSourcePosition(1,1,file),m_sourceCode(sourceCode),m_sourceIndex(0) {}
+    TextFileReader(const std::string& sourceCode, int firstLine, SourcePositionFile file):m_currentSourcePosition(firstLine,1,file),m_sourceCode(sourceCode),m_sourceIndex(0) {}
     const SourcePosition& sourcePosition() const {
         return m_currentSourcePosition;
     }
@@ -15,6 +15,7 @@
 #include "SpinCompiler/Types/Token.h"
 #include "SpinCompiler/Types/CompilerError.h"
 #include "SpinCompiler/Types/ConstantExpression.h"
+#include <algorithm>
 
 class TokenReader {
 private:
@@ -36,6 +37,14 @@ public:
         m_tokenIndex = TokenIndex(0);
     }
 
+    TokenIndex getTokenIndex() const {
+        return m_tokenIndex;
+    }
+
+    void setTokenIndex(TokenIndex tokenIndex) {
+        m_tokenIndex = tokenIndex;
+    }
+
     void goBack() {
         if (m_tokenIndex.value()>0)
             m_tokenIndex = TokenIndex(m_tokenIndex.value()-1);
@@ -127,30 +136,39 @@ public:
         }
     }
 
-    bool getNextBlock(BlockType::Type type) {
-        if (m_tokenIndex.value() == 0) {
-            if (!m_tokenList.indexOfFirstBlock.valid())
-                return false;
-            m_tokenIndex = m_tokenList.indexOfFirstBlock;
-        }
-        while(true) {
-            auto tk = getNextToken();
-            if (tk.eof)
-                return false;
-            if (tk.type != Token::Block)
-                continue;
-            if (tk.value == type) {
-                if (tk.sourcePosition.column != 1)
-                    throw CompilerError(ErrorType::bdmbifc, tk);
-                return true;
+    // skips the rest of the current line, used to resume parsing after an error
+    void skipLine() {
+        while (true) {
+            Token tk = getNextToken();
+            if (tk.eof || tk.type == Token::End)
+                return;
+            if (tk.type == Token::Block) {
+                goBack();
+                return;
             }
-            const int jumpBy = tk.opType;
-            if (jumpBy<0)
-                return false;
-            m_tokenIndex = TokenIndex(m_tokenIndex.value()+jumpBy-1); //getNextToken() already incremented by 1
         }
     }
 
+    bool getNextBlock(BlockType::Type type) {
+        //first block of the requested type at or behind the current position
+        const auto& blocks = m_tokenList.blocksByType[type];
+        auto block = std::lower_bound(blocks.begin(), blocks.end(), m_tokenIndex, [](const TokenList::BlockRange& range, TokenIndex index) { return range.begin < index; });
+        if (block == blocks.end()) {
+            //leave the reader where scanning through all blocks would have ended, error positions depend on it
+            const TokenIndex lastBlock = m_tokenList.indexOfLastBlock;
+            if (lastBlock.valid() && m_tokenIndex <= lastBlock)
+                m_tokenIndex = TokenIndex(lastBlock.value()+1);
+            else if (lastBlock.valid() || m_tokenIndex.value()>0)
+                m_tokenIndex = TokenIndex(std::max(m_tokenIndex.value(), int(m_tokenList.tokens.size()))+1);
+            return false;
+        }
+        const Token& tk = m_tokenList.tokens[block->begin.value()];
+        m_tokenIndex = TokenIndex(block->begin.value()+1);
+        if (tk.sourcePosition.column != 1)
+            throw CompilerError(ErrorType::bdmbifc, tk);
+        return true;
+    }
+
     // check if next element is of the given type, if so return true, if not, backup and return false
     bool checkElement(Token::Type type) {
         if (getNextToken().type == type)
@@ -12,9 +12,12 @@
 #define SPINCOMPILER_TOKENIZER_H
 
 #include <string>
+#include <vector>
+#include <iterator>
 #include "SpinCompiler/Tokenizer/TextFileReader.h"
 #include "SpinCompiler/Tokenizer/SpinBuiltInSymbolMap.h"
 #include "SpinCompiler/Tokenizer/FloatParser.h"
+#include "SpinCompiler/Types/ThreadPool.h"
 
 class Tokenizer {
 private:
@@ -24,32 +27,148 @@ private:
     int m_sourceFlags;
 public:
     static TokenList readTokenList(const SpinBuiltInSymbolMap &builtInSymbols, const std::string& sourceCode, SourcePositionFile file) {
-        Tokenizer tokenizer(builtInSymbols,sourceCode,file);
         TokenList tokenList;
+        tokenList.tokens = readTokens(builtInSymbols, sourceCode, 1, file);
+        indexBlocks(tokenList);
+        return tokenList;
+    }
+    //large files are split at blocks starting in column 1, the parts are tokenized in parallel
+    static TokenList readTokenList(const SpinBuiltInSymbolMap &builtInSymbols, const std::string& sourceCode, SourcePositionFile file, ThreadPool& pool) {
+        const auto chunks = pool.threadCount() > 1 ? findChunks(builtInSymbols, sourceCode) : std::vector<Chunk>();
+        if (chunks.size() < 2)
+            return readTokenList(builtInSymbols, sourceCode, file);
+        const auto astArena = AstArena::current(); //constant tokens carry expressions
+        std::vector<std::future<std::vector<Token>>> results;
+        results.reserve(chunks.size());
+        for (const auto& chunk:chunks) {
+            results.push_back(pool.submit([&builtInSymbols, &sourceCode, chunk, file, astArena]() {
+                AstArena::Scope astScope(astArena);
+                return readTokens(builtInSymbols, sourceCode.substr(chunk.begin, chunk.end-chunk.begin), chunk.line, file);
+            }));
+        }
+        // wait for all parts, report the error of the first part like tokenizing the whole file would do
+        std::vector<std::vector<Token>> chunkTokens(results.size());
+        std::exception_ptr firstError;
+        std::size_t tokenCount = 0;
+        for (std::size_t i=0; i<results.size(); ++i) {
+            try {
+                chunkTokens[i] = results[i].get();
+                tokenCount += chunkTokens[i].size();
+            }
+            catch (...) {
+                if (!firstError)
+                    firstError = std::current_exception();
+            }
+        }
+        if (firstError)
+            std::rethrow_exception(firstError);
+        TokenList tokenList;
+        tokenList.tokens.reserve(tokenCount);
+        for (auto& tokens:chunkTokens)
+            tokenList.tokens.insert(tokenList.tokens.end(), std::make_move_iterator(tokens.begin()), std::make_move_iterator(tokens.end()));
+        indexBlocks(tokenList);
+        return tokenList;
+    }
+private:
+    static std::vector<Token> readTokens(const SpinBuiltInSymbolMap &builtInSymbols, const std::string& sourceCode, int firstLine, SourcePositionFile file) {
+        Tokenizer tokenizer(builtInSymbols,sourceCode,firstLine,file);
+        std::vector<Token> tokens;
         while (true) {
             auto tk = tokenizer.getNextToken();
             if (tk.eof)
                 break;
-            tokenList.tokens.push_back(tk);
+            tokens.push_back(tk);
         }
-        //generate block jump table
+        return tokens;
+    }
+
+    static void indexBlocks(TokenList& tokenList) {
+        //generate block index, so each pass may jump directly to the blocks of its type
         int lastBlock = -1;
-        for (int i=0; i<int(tokenList.tokens.size()); ++i) {
-            if (tokenList.tokens[i].type != Token::Block)
+        for (int i=0; i<=int(tokenList.tokens.size()); ++i) {
+            if (i<int(tokenList.tokens.size()) && tokenList.tokens[i].type != Token::Block)
                 continue;
-            if (lastBlock == -1)
-                tokenList.indexOfFirstBlock = TokenIndex(i);
-            else
-                tokenList.tokens[lastBlock].opType = i-lastBlock; //jump amount to next block
+            if (lastBlock>=0)
+                tokenList.blocksByType[tokenList.tokens[lastBlock].value].push_back(TokenList::BlockRange(TokenIndex(lastBlock),TokenIndex(i)));
             lastBlock = i;
         }
-        if (lastBlock>=0)
-            tokenList.tokens[lastBlock].opType = -1; //end of tbl
-        return tokenList;
+        for (const auto& blocks:tokenList.blocksByType)
+            if (!blocks.empty() && blocks.back().end.value() == int(tokenList.tokens.size()))
+                tokenList.indexOfLastBlock = blocks.back().begin;
     }
-private:
-    Tokenizer(const SpinBuiltInSymbolMap &builtInSymbols, const std::string& sourceCode, SourcePositionFile file):
-        m_textFileReader(sourceCode, file),
+
+    struct Chunk {
+        Chunk(int begin, int line):begin(begin),end(0),line(line) {}
+        int begin;
+        int end;
+        int line;
+    };
+
+    //skips comments and strings the same way getNextToken does, a line outside of them always starts with the tokenizer in its initial state
+    static std::vector<Chunk> findChunks(const SpinBuiltInSymbolMap &builtInSymbols, const std::string& sourceCode) {
+        std::vector<Chunk> chunks;
+        if (int(sourceCode.size()) < 2*MinChunkSize)
+            return chunks;
+        const char *src = sourceCode.c_str();
+        int pos = 0;
+        int line = 1;
+        chunks.push_back(Chunk(0,1));
+        while (src[pos]) {
+            const char currentChar = src[pos++];
+            if (currentChar == 13) {
+                ++line;
+                if (pos-chunks.back().begin >= MinChunkSize && startsWithBlock(builtInSymbols, src+pos)) {
+                    chunks.back().end = pos;
+                    chunks.push_back(Chunk(pos,line));
+                }
+            }
+            else if (currentChar == '\'') {
+                while (src[pos] && src[pos] != 13)
+                    ++pos;
+            }
+            else if (currentChar == '\"') {
+                while (src[pos] && src[pos] != 13 && src[pos++] != '\"') {
+                }
+            }
+            else if (currentChar == '{') {
+                const bool docComment = src[pos] == '{';
+                if (docComment)
+                    ++pos;
+                int braceCommentLevel = 1;
+                while (src[pos]) {
+                    const char commentChar = src[pos++];
+                    if (commentChar == 13)
+                        ++line;
+                    else if (!docComment && commentChar == '{')
+                        braceCommentLevel++;
+                    else if (commentChar == '}') {
+                        if (docComment && src[pos] == '}') {
+                            ++pos;
+                            break;
+                        }
+                        else if (!docComment && --braceCommentLevel < 1)
+                            break;
+                    }
+                }
+            }
+        }
+        chunks.back().end = pos; //the tokenizer stops at the first 0 as well
+        return chunks;
+    }
+
+    static bool startsWithBlock(const SpinBuiltInSymbolMap &builtInSymbols, const char *src) {
+        std::string symbolName;
+        while (checkWordChar(uppercase(*src)))
+            symbolName.push_back(uppercase(*src++));
+        if (symbolName.empty())
+            return false;
+        Token tk(SpinSymbolId(),Token::Undefined,0,SourcePosition());
+        builtInSymbols.hasSymbol(builtInSymbols.stringMap.hasSymbolName(symbolName), tk);
+        return tk.type == Token::Block;
+    }
+
+    Tokenizer(const SpinBuiltInSymbolMap &builtInSymbols, const std::string& sourceCode, int firstLine, SourcePositionFile file):
+        m_textFileReader(sourceCode, firstLine, file),
         m_builtInSymbols(builtInSymbols),
         m_sourceFlags(0) {
     }
@@ -408,7 +527,7 @@ private:
         return ((theChar >= '0' && theChar <= '9') || (theChar == '_') || (theChar >= 'A' && theChar <= 'Z'));
     }
 
-    enum { FloatTempBufferSize = 127 };
+    enum { FloatTempBufferSize = 127, MinChunkSize = 64*1024 };
 };
 
 #endif //SPINCOMPILER_TOKENIZER_H
@@ -13,9 +13,13 @@
 
 #include "SpinCompiler/Types/StrongTypedefInt.h"
 #include <string>
+#include <atomic>
+#include <thread>
 
 class AbstractBinaryGenerator {
 public:
+    //all generators of one compilation share the thread they evaluate on
+    explicit AbstractBinaryGenerator(std::thread::id evaluationThread):evaluationThread(evaluationThread),m_evaluationEpoch(nextEvaluationEpoch()) {}
     virtual ~AbstractBinaryGenerator() {}
     virtual int mapObjectInstanceIdToOffset(ObjectInstanceId objectIndexId) const=0;
     virtual int valueOfConstantOfObjectClass(ObjectClassId objectClass, int constantIndex) const=0;
@@ -25,6 +29,25 @@ public:
     virtual int addressOfVarSymbol(VarSymbolId varSymbolId) const=0;
     virtual std::string getNameBySymbolId(SpinSymbolId symbol) const=0;
     virtual int addressOfLocSymbol(LocSymbolId locSymbolId) const=0; //for current method
+
+    //constant expressions memoize in their nodes without locking, the nodes are shared by all objects of the compilation
+    //so evaluating them is restricted to this thread
+    const std::thread::id evaluationThread;
+
+    //unique for each generator and state of its dat symbols, constant expressions memoize their value per epoch
+    unsigned long long evaluationEpoch() const {
+        return m_evaluationEpoch;
+    }
+protected:
+    void invalidateEvaluations() {
+        m_evaluationEpoch = nextEvaluationEpoch();
+    }
+private:
+    unsigned long long m_evaluationEpoch;
+    static unsigned long long nextEvaluationEpoch() {
+        static std::atomic<unsigned long long> lastEpoch(0);
+        return ++lastEpoch;
+    }
 };
 
 #endif //SPINCOMPILER_ABSTRACTBINARYGENERATOR_H
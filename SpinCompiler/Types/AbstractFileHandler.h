@@ -59,6 +59,29 @@ public:
      * if the file was not found or available, a CompilerError must be thrown
      */
     virtual FileDescriptorP findFile(const std::string& fileName, FileType fileType, FileDescriptorP parent, const SourcePosition& includedInPosition)=0;
+
+    /*
+     * This function is a hint that findFile will be called soon with the same fileName and fileType
+     * An implementation may start reading the file in the background, errors must not be reported here
+     * but by the following findFile call
+     */
+    virtual void prefetchFile(const std::string&, FileType) {
+    }
+
+    /*
+     * Returns the paths of all files returned by findFile so far, in the order they were found
+     * This is used to write dependency files for build systems
+     */
+    virtual std::vector<std::string> dependencies() const {
+        return std::vector<std::string>();
+    }
+protected:
+    //spin files may be given without extension
+    static std::string fileNameWithExtension(const std::string& fileName, FileType fileType) {
+        if (fileType == SpinFile && (fileName.size()<5 || fileName.substr(fileName.size()-5) != ".spin"))
+            return fileName+".spin";
+        return fileName;
+    }
 };
 
 
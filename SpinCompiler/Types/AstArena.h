@@ -0,0 +1,156 @@
+//////////////////////////////////////////////////////////////
+//                                                          //
+// Propeller Spin/PASM Compiler                             //
+// (c)2012-2016 Parallax Inc. DBA Parallax Semiconductor.   //
+// Adapted from Chip Gracey's x86 asm code by Roy Eltham    //
+// Rewritten to modern C++ by Thilo Ackermann               //
+// See end of file for terms of use.                        //
+//                                                          //
+////////////////////////////////////////////////////////////// 
+
+#ifndef SPINCOMPILER_ASTARENA_H
+#define SPINCOMPILER_ASTARENA_H
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+// Bump allocator for the nodes of the syntax trees (expressions, instructions, constant expressions).
+// Nodes are still referenced by shared_ptr, as trees share nodes with each other and with the exports of child objects,
+// but node and reference count live in one allocation inside a large chunk. Freeing a node does nothing,
+// all chunks are released together with the arena. The arena must outlive all of its nodes: the parser owns the
+// arena of the object level nodes, every method owns one for its body, dropped once its byte code is generated.
+// Allocators keep a raw pointer, so creating a node does not touch a shared reference count.
+// Every thread bumps in its own chunk, so parallel parsers do not lock for each node.
+
+class AstArena {
+private:
+    struct Cursor {
+        Cursor():arenaId(0),pos(nullptr),end(nullptr) {}
+        std::uint64_t arenaId; //the cursor belongs to another arena if it differs
+        char *pos;
+        char *end;
+    };
+public:
+    static const std::size_t ChunkSize = 64*1024;
+    static const std::size_t MethodChunkSize = 4*1024; //first chunk of a method body arena, most bodies are small
+
+    //chunks grow from firstChunkSize up to ChunkSize
+    explicit AstArena(std::size_t firstChunkSize = ChunkSize):m_id(nextArenaId()),m_nextChunkSize(firstChunkSize) {}
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t alignment) {
+        Cursor& cursor = threadCursor();
+        if (cursor.arenaId != m_id || padding(cursor.pos, alignment)+size > std::size_t(cursor.end-cursor.pos)) {
+            std::size_t chunkSize = 0;
+            cursor.arenaId = m_id;
+            cursor.pos = newChunk(size+alignment, chunkSize);
+            cursor.end = cursor.pos+chunkSize;
+        }
+        char *result = cursor.pos+padding(cursor.pos, alignment);
+        cursor.pos = result+size;
+        return result;
+    }
+
+    template<typename T> struct Allocator {
+        typedef T value_type;
+        explicit Allocator(AstArena* arena):arena(arena) {}
+        template<typename U> Allocator(const Allocator<U>& other):arena(other.arena) {}
+        T* allocate(std::size_t n) {
+            return static_cast<T*>(arena->allocate(n*sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, std::size_t) {} //released with the arena
+        template<typename U> bool operator==(const Allocator<U>& other) const {
+            return arena == other.arena;
+        }
+        template<typename U> bool operator!=(const Allocator<U>& other) const {
+            return arena != other.arena;
+        }
+        AstArena* arena; //owned by the parser, which outlives all nodes
+    };
+
+    //arena used by create in this thread, nodes are allocated on the heap if there is none
+    static std::shared_ptr<AstArena>& current() {
+        static thread_local std::shared_ptr<AstArena> arena;
+        return arena;
+    }
+
+    //makes an arena the current one of this thread as long as the scope exists
+    //leaving the scope of another arena continues in the previous chunk, so nesting method arenas does not waste chunks
+    class Scope {
+    public:
+        explicit Scope(std::shared_ptr<AstArena> arena):m_previous(current()),m_previousCursor(threadCursor()) {
+            current() = arena;
+        }
+        ~Scope() {
+            current() = m_previous;
+            if (threadCursor().arenaId != m_previousCursor.arenaId) //the same arena has moved on
+                threadCursor() = m_previousCursor;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        std::shared_ptr<AstArena> m_previous; //keeps the arena of m_previousCursor alive
+        Cursor m_previousCursor;
+    };
+
+    template<typename T, typename... Args> static std::shared_ptr<T> create(Args&&... args) {
+        const auto& arena = current();
+        if (arena)
+            return std::allocate_shared<T>(Allocator<T>(arena.get()), std::forward<Args>(args)...);
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+private:
+    const std::uint64_t m_id;
+    std::mutex m_mutex;
+    std::size_t m_nextChunkSize;
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+
+    char* newChunk(std::size_t minSize, std::size_t& size) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size = minSize > m_nextChunkSize ? minSize : m_nextChunkSize;
+        if (m_nextChunkSize < ChunkSize)
+            m_nextChunkSize *= 2;
+        m_chunks.push_back(std::unique_ptr<char[]>(new char[size]));
+        return m_chunks.back().get();
+    }
+    static std::size_t padding(const char *pos, std::size_t alignment) {
+        return (alignment - reinterpret_cast<std::uintptr_t>(pos) % alignment) % alignment;
+    }
+    static Cursor& threadCursor() {
+        static thread_local Cursor cursor;
+        return cursor;
+    }
+    static std::uint64_t nextArenaId() {
+        static std::atomic<std::uint64_t> lastId(0);
+        return ++lastId;
+    }
+};
+
+typedef std::shared_ptr<AstArena> AstArenaP;
+
+#endif //SPINCOMPILER_ASTARENA_H
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//                           TERMS OF USE: MIT License                                   //
+///////////////////////////////////////////////////////////////////////////////////////////
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this  //
+// software and associated documentation files (the "Software"), to deal in the Software //
+// without restriction, including without limitation the rights to use, copy, modify,    //
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to    //
+// permit persons to whom the Software is furnished to do so, subject to the following   //
+// conditions:                                                                           //
+//                                                                                       //
+// The above copyright notice and this permission notice shall be included in all copies //
+// or substantial portions of the Software.                                              //
+//                                                                                       //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,   //
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A         //
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT    //
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION     //
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE        //
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                                //
+///////////////////////////////////////////////////////////////////////////////////////////
@@ -37,6 +37,17 @@ struct BinaryAnnotation {
         explicit DatAnnotation(const std::vector<Entry> &entries):entries(entries) {}
 
 
+        std::vector<Entry> entries;
+    };
+    struct MethodSourceMap : public AbstractExtraInfo {
+        struct Entry {
+            Entry(int offset, int line):offset(offset),line(line) {}
+            int offset; //relative to the start of the method
+            int line;
+        };
+
+        virtual ~MethodSourceMap() {}
+
         std::vector<Entry> entries;
     };
     typedef std::shared_ptr<TableEntryNames> TableEntryNamesP;
@@ -13,6 +13,7 @@
 
 #include "SpinCompiler/Types/SourcePosition.h"
 #include "SpinCompiler/Types/Token.h"
+#include <vector>
 
 enum struct ErrorType {
     ainl,
@@ -21,6 +22,7 @@ enum struct ErrorType {
     bdmbifc,
     bnso,
     ccsronfp,
+    cdic,
     ce32b,
     coxmbs,
     csmnexc,
@@ -151,6 +153,63 @@ struct CompilerError {
     std::string extraMessage;
 };
 
+//several errors of independent parts, thrown instead of a single CompilerError when error recovery collected more than one
+struct CompilerErrorList {
+    explicit CompilerErrorList(const std::vector<CompilerError>& errors):errors(errors) {}
+    std::vector<CompilerError> errors;
+};
+
+//collects the errors of independent parts (statements, methods, definitions, child objects), so one compile reports
+//more than one error, reaching maxErrors throws all collected errors, with maxErrors 1 the first error is thrown as is
+class CompilerErrorCollector {
+public:
+    explicit CompilerErrorCollector(int maxErrors):m_maxErrors(maxErrors),m_stopped(false) {}
+    //runs a part, its errors are collected instead of thrown, returns false if it failed
+    template<typename F> bool recover(F part) {
+        try {
+            part();
+            return true;
+        }
+        catch (const CompilerError& e) {
+            if (m_stopped) //thrown by a nested part reaching maxErrors
+                throw;
+            add(e);
+        }
+        catch (const CompilerErrorList& list) {
+            if (m_stopped)
+                throw;
+            for (const auto& e:list.errors)
+                add(e);
+        }
+        return false;
+    }
+    bool hasErrors() const {
+        return !m_errors.empty();
+    }
+    int maxErrors() const {
+        return m_maxErrors;
+    }
+    //called between phases, later phases would only report follow-up errors of a failed part
+    void throwIfAny() const {
+        if (m_errors.size() == 1)
+            throw m_errors.front();
+        if (!m_errors.empty())
+            throw CompilerErrorList(m_errors);
+    }
+private:
+    int m_maxErrors; //0 for no limit
+    bool m_stopped;
+    std::vector<CompilerError> m_errors;
+
+    void add(const CompilerError& e) {
+        m_errors.push_back(e);
+        if (m_maxErrors > 0 && int(m_errors.size()) >= m_maxErrors) {
+            m_stopped = true;
+            throwIfAny();
+        }
+    }
+};
+
 class CompilerMessages {
 public:
     CompilerMessages():m_messageText {
@@ -160,6 +219,7 @@ public:
     {ErrorType::bdmbifc,   "bdmbifc",  "Block designator must be in first column"},
     {ErrorType::bnso,      "bnso",     "Blocknest stack overflow"},
     {ErrorType::ccsronfp,  "ccsronfp", "Cannot compute square root of negative floating-point number"},
+    {ErrorType::cdic,      "cdic",     "Constant definition is circular"},
     {ErrorType::ce32b,     "ce32b",    "Constant exceeds 32 bits"},
     {ErrorType::coxmbs,    "coxmbs",   "_CLKFREQ or _XINFREQ must be specified"},
     {ErrorType::csmnexc,   "csmnexc",  "CALL symbol must not exceed 252 characters"},
@@ -26,16 +26,25 @@ struct CompilerSettings {
         HTML,
         AST
     };
+    enum struct Optimization {
+        O0, // no optimization, byte-exact to the Propeller Tool
+        O1, // cheap AST and byte code passes
+        O2, // all passes, favoring speed
+        Os  // all passes that do not increase size
+    };
 
-    CompilerSettings():eepromSize(32768),unusedMethodOptimization(UnusedMethods::Keep),annotatedOutput(AnnotatedOutput::None),defaultCompileMode(true),usePreProcessor(true),compileDatOnly(false),binaryMode(true) {}
+    CompilerSettings():eepromSize(32768),unusedMethodOptimization(UnusedMethods::Keep),annotatedOutput(AnnotatedOutput::None),optimization(Optimization::O0),defaultCompileMode(true),usePreProcessor(true),compileDatOnly(false),binaryMode(true),strictMode(false),maxErrors(1) {}
     std::map<std::string,std::string> preDefinedMacros;
     int eepromSize;
     UnusedMethods unusedMethodOptimization;
     AnnotatedOutput annotatedOutput;
+    Optimization optimization;
     bool defaultCompileMode;
     bool usePreProcessor;
     bool compileDatOnly;
     bool binaryMode;
+    bool strictMode; // parse all method bodies, even those removed by unused method elimination
+    int maxErrors; // errors reported before compiling stops, 0 for no limit
 };
 
 #endif //SPINCOMPILER_COMPILERSETTINGS_H
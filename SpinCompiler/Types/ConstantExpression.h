@@ -14,51 +14,69 @@
 #include "SpinCompiler/Types/Token.h"
 #include "SpinCompiler/Types/CompilerError.h"
 #include "SpinCompiler/Types/AbstractBinaryGenerator.h"
+#include "SpinCompiler/Types/AstArena.h"
 #include <math.h>
 
+struct AbstractConstantExpression;
+
+//one step of a constant expression lowered to reverse polish notation
+struct ConstantExpressionOp {
+    enum Code { PushValue, Unary, Binary, CurrentCogPos, DatSymbol, ChildObjConstant };
+    ConstantExpressionOp(Code code, const AbstractConstantExpression* node, int value):code(code),value(value),node(node) {}
+    Code code;
+    int value; //only for PushValue
+    const AbstractConstantExpression* node; //node this step was lowered from
+};
+
 struct AbstractConstantExpression {
+    enum Kind {
+        ValueNode,
+        UnaryNode,
+        BinaryNode,
+        DatCurrentCogPosNode,
+        DatSymbolNode,
+        ChildObjConstantNode
+    };
+    const Kind kind;
     SourcePosition sourcePosition;
-    AbstractConstantExpression(const SourcePosition& sourcePosition):sourcePosition(sourcePosition) {}
+    AbstractConstantExpression(Kind kind, const SourcePosition& sourcePosition):kind(kind),sourcePosition(sourcePosition),m_stackDepth(0),m_dependsOnCogPos(false),m_cachedEpoch(0),m_cachedValue(0) {}
     virtual ~AbstractConstantExpression() {}
-    virtual int evaluate(AbstractBinaryGenerator* generator) const = 0;
+    //the tree is lowered to a flat program on first use, results are memoized per evaluation epoch of the generator
+    //not thread safe: only called on the evaluation thread of the generator, parser threads use isConstant
+    int evaluate(AbstractBinaryGenerator* generator) const;
     virtual std::string toILangStr() const = 0;
-    virtual bool isConstant(int *) const {
-        return false;
-    }
+    bool isConstant(int *resultValue) const;
+private:
+    mutable std::vector<ConstantExpressionOp> m_program;
+    mutable int m_stackDepth;
+    mutable bool m_dependsOnCogPos; //current cog position is not covered by the epoch, never memoize
+    mutable unsigned long long m_cachedEpoch; //0 if nothing cached
+    mutable int m_cachedValue;
+
+    int lower(const AbstractConstantExpression& node, int depth) const;
+    int runProgram(AbstractBinaryGenerator* generator) const;
 };
 typedef std::shared_ptr<AbstractConstantExpression> AbstractConstantExpressionP;
 
 struct ConstantValueExpression : AbstractConstantExpression {
     const int value;
-    ConstantValueExpression(const SourcePosition& sourcePosition, int value):AbstractConstantExpression(sourcePosition),value(value) {};
+    ConstantValueExpression(const SourcePosition& sourcePosition, int value):AbstractConstantExpression(ValueNode, sourcePosition),value(value) {};
     virtual ~ConstantValueExpression() {}
     static std::shared_ptr<ConstantValueExpression> create(const SourcePosition& sourcePosition, int value) {
-        return std::shared_ptr<ConstantValueExpression>(new ConstantValueExpression(sourcePosition,value));
-    }
-    virtual int evaluate(AbstractBinaryGenerator*) const {
-        return value;
+        return AstArena::create<ConstantValueExpression>(sourcePosition,value);
     }
     virtual std::string toILangStr() const {
         return std::to_string(value);
     };
-    virtual bool isConstant(int *resultValue) const {
-        if (resultValue)
-            *resultValue = value;
-        return true;
-    }
 };
 
 struct UnaryConstantExpression : public AbstractConstantExpression {
-    UnaryConstantExpression(const SourcePosition& sourcePosition, AbstractConstantExpressionP param, OperatorType::Type operation, bool floatMode):AbstractConstantExpression(sourcePosition),param(param),operation(operation),floatMode(floatMode) {}
+    UnaryConstantExpression(const SourcePosition& sourcePosition, AbstractConstantExpressionP param, OperatorType::Type operation, bool floatMode):AbstractConstantExpression(UnaryNode, sourcePosition),param(param),operation(operation),floatMode(floatMode) {}
     virtual ~UnaryConstantExpression() {}
     const AbstractConstantExpressionP param;
     const OperatorType::Type operation;
     const bool floatMode;
 
-    virtual int evaluate(AbstractBinaryGenerator* generator) const {
-        return performOpUnary(param->evaluate(generator), operation, floatMode, sourcePosition);
-    }
-
     static int performOpUnary(const int value1, const OperatorType::Type operation, const bool isFloatMode, const SourcePosition& sourcePosition) {
         switch(operation) {
             case OperatorType::OpNeg:
@@ -125,17 +143,13 @@ struct UnaryConstantExpression : public AbstractConstantExpression {
 };
 
 struct BinaryConstantExpression : public AbstractConstantExpression {
-    BinaryConstantExpression(const SourcePosition& sourcePosition, AbstractConstantExpressionP left, OperatorType::Type operation, AbstractConstantExpressionP right, bool floatMode):AbstractConstantExpression(sourcePosition),left(left),right(right),operation(operation),floatMode(floatMode) {}
+    BinaryConstantExpression(const SourcePosition& sourcePosition, AbstractConstantExpressionP left, OperatorType::Type operation, AbstractConstantExpressionP right, bool floatMode):AbstractConstantExpression(BinaryNode, sourcePosition),left(left),right(right),operation(operation),floatMode(floatMode) {}
     virtual ~BinaryConstantExpression() {}
     const AbstractConstantExpressionP left;
     const AbstractConstantExpressionP right;
     const OperatorType::Type operation;
     const bool floatMode;
 
-    virtual int evaluate(AbstractBinaryGenerator* generator) const {
-        return performOpBinary(left->evaluate(generator), right->evaluate(generator), operation, floatMode);
-    }
-
     static int performOpBinary(const int value1, const int value2, const OperatorType::Type operation, const bool isFloatMode) {
         switch(operation) {
             case OperatorType::OpRor:
@@ -254,42 +268,133 @@ struct BinaryConstantExpression : public AbstractConstantExpression {
 };
 
 struct DatCurrentCogPosConstantExpression : public AbstractConstantExpression {
-    explicit DatCurrentCogPosConstantExpression(const SourcePosition& sourcePosition):AbstractConstantExpression(sourcePosition) {}
+    explicit DatCurrentCogPosConstantExpression(const SourcePosition& sourcePosition):AbstractConstantExpression(DatCurrentCogPosNode, sourcePosition) {}
     virtual ~DatCurrentCogPosConstantExpression() {}
-    virtual int evaluate(AbstractBinaryGenerator* generator) const {
-        return generator->currentDatCogOrg() >> 2;
-    }
     virtual std::string toILangStr() const {
         return "(currentCogPos)";
     }
 };
 
 struct DatSymbolConstantExpression : public AbstractConstantExpression {
-    DatSymbolConstantExpression(const SourcePosition& sourcePosition, DatSymbolId datSymbolId, bool isCogPos):AbstractConstantExpression(sourcePosition),datSymbolId(datSymbolId),isCogPos(isCogPos) {}
+    DatSymbolConstantExpression(const SourcePosition& sourcePosition, DatSymbolId datSymbolId, bool isCogPos):AbstractConstantExpression(DatSymbolNode, sourcePosition),datSymbolId(datSymbolId),isCogPos(isCogPos) {}
     virtual ~DatSymbolConstantExpression() {}
     const DatSymbolId datSymbolId;
     const bool isCogPos;
-    virtual int evaluate(AbstractBinaryGenerator* generator) const {
-        return generator->valueOfDatSymbol(datSymbolId, isCogPos);
-    }
     virtual std::string toILangStr() const {
         return (isCogPos ? "(cogPos " : "(datPos ")+std::to_string(datSymbolId.value())+")";
     }
 };
 
 struct ChildObjConstantExpression : public AbstractConstantExpression {
-    explicit ChildObjConstantExpression(const SourcePosition& sourcePosition, ObjectClassId objectClass, int constantIndex):AbstractConstantExpression(sourcePosition),objectClass(objectClass),constantIndex(constantIndex) {}
+    explicit ChildObjConstantExpression(const SourcePosition& sourcePosition, ObjectClassId objectClass, int constantIndex):AbstractConstantExpression(ChildObjConstantNode, sourcePosition),objectClass(objectClass),constantIndex(constantIndex) {}
     virtual ~ChildObjConstantExpression() {}
     const ObjectClassId objectClass;
     const int constantIndex;
-    virtual int evaluate(AbstractBinaryGenerator* generator) const {
-        return generator->valueOfConstantOfObjectClass(objectClass, constantIndex);
-    }
     virtual std::string toILangStr() const {
         return "(objconst "+std::to_string(objectClass.value())+" "+std::to_string(constantIndex)+")";
     }
 };
 
+inline bool AbstractConstantExpression::isConstant(int *resultValue) const {
+    if (kind != ValueNode)
+        return false;
+    if (resultValue)
+        *resultValue = static_cast<const ConstantValueExpression*>(this)->value;
+    return true;
+}
+
+inline int AbstractConstantExpression::evaluate(AbstractBinaryGenerator* generator) const {
+    if (kind == ValueNode)
+        return static_cast<const ConstantValueExpression*>(this)->value;
+    if (generator->evaluationThread != std::this_thread::get_id())
+        throw CompilerError(ErrorType::internal, sourcePosition);
+    const unsigned long long epoch = generator->evaluationEpoch();
+    if (m_cachedEpoch == epoch)
+        return m_cachedValue;
+    if (m_program.empty())
+        m_stackDepth = lower(*this, 1);
+    const int value = runProgram(generator);
+    if (!m_dependsOnCogPos) {
+        m_cachedEpoch = epoch;
+        m_cachedValue = value;
+    }
+    return value;
+}
+
+//appends node in post order, returns the stack depth required
+inline int AbstractConstantExpression::lower(const AbstractConstantExpression& node, int depth) const {
+    switch(node.kind) {
+        case ValueNode:
+            m_program.push_back(ConstantExpressionOp(ConstantExpressionOp::PushValue, &node, static_cast<const ConstantValueExpression&>(node).value));
+            return depth;
+        case UnaryNode: {
+            const int paramDepth = lower(*static_cast<const UnaryConstantExpression&>(node).param, depth);
+            m_program.push_back(ConstantExpressionOp(ConstantExpressionOp::Unary, &node, 0));
+            return paramDepth;
+        }
+        case BinaryNode: {
+            const int leftDepth = lower(*static_cast<const BinaryConstantExpression&>(node).left, depth);
+            const int rightDepth = lower(*static_cast<const BinaryConstantExpression&>(node).right, depth+1);
+            m_program.push_back(ConstantExpressionOp(ConstantExpressionOp::Binary, &node, 0));
+            return leftDepth > rightDepth ? leftDepth : rightDepth;
+        }
+        case DatCurrentCogPosNode:
+            m_dependsOnCogPos = true;
+            m_program.push_back(ConstantExpressionOp(ConstantExpressionOp::CurrentCogPos, &node, 0));
+            return depth;
+        case DatSymbolNode:
+            m_program.push_back(ConstantExpressionOp(ConstantExpressionOp::DatSymbol, &node, 0));
+            return depth;
+        case ChildObjConstantNode:
+            m_program.push_back(ConstantExpressionOp(ConstantExpressionOp::ChildObjConstant, &node, 0));
+            return depth;
+    }
+    throw CompilerError(ErrorType::internal, node.sourcePosition);
+}
+
+inline int AbstractConstantExpression::runProgram(AbstractBinaryGenerator* generator) const {
+    int smallStack[16] = {};
+    std::vector<int> largeStack;
+    int *stack = smallStack;
+    if (m_stackDepth > 16) {
+        largeStack.resize(m_stackDepth);
+        stack = largeStack.data();
+    }
+    int top = -1;
+    for (const auto& op:m_program) {
+        switch(op.code) {
+            case ConstantExpressionOp::PushValue:
+                stack[++top] = op.value;
+                break;
+            case ConstantExpressionOp::Unary: {
+                auto node = static_cast<const UnaryConstantExpression*>(op.node);
+                stack[top] = UnaryConstantExpression::performOpUnary(stack[top], node->operation, node->floatMode, node->sourcePosition);
+                break;
+            }
+            case ConstantExpressionOp::Binary: {
+                auto node = static_cast<const BinaryConstantExpression*>(op.node);
+                --top;
+                stack[top] = BinaryConstantExpression::performOpBinary(stack[top], stack[top+1], node->operation, node->floatMode);
+                break;
+            }
+            case ConstantExpressionOp::CurrentCogPos:
+                stack[++top] = generator->currentDatCogOrg() >> 2;
+                break;
+            case ConstantExpressionOp::DatSymbol: {
+                auto node = static_cast<const DatSymbolConstantExpression*>(op.node);
+                stack[++top] = generator->valueOfDatSymbol(node->datSymbolId, node->isCogPos);
+                break;
+            }
+            case ConstantExpressionOp::ChildObjConstant: {
+                auto node = static_cast<const ChildObjConstantExpression*>(op.node);
+                stack[++top] = generator->valueOfConstantOfObjectClass(node->objectClass, node->constantIndex);
+                break;
+            }
+        }
+    }
+    return stack[0];
+}
+
 #endif //SPINCOMPILER_CONSTANTEXPRESSION_H
 
 ///////////////////////////////////////////////////////////////////////////////////////////
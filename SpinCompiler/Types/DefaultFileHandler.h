@@ -13,53 +13,208 @@
 
 #include "SpinCompiler/Types/AbstractFileHandler.h"
 #include "SpinCompiler/Types/CompilerError.h"
+#include "SpinCompiler/Types/ThreadPool.h"
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <fstream>
+#include <cctype>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
 
 class DefaultFileHandler : public AbstractFileHandler {
 private:
+    // directory listing, read once per directory
+    struct DirectoryIndex {
+        DirectoryIndex():listed(false) {}
+        bool listed; //false if the directory could not be enumerated, lookups fall back to opening the file
+        std::unordered_set<std::string> names;
+        std::unordered_map<std::string, std::string> lowerCaseNames; //lower case name -> name as stored on disk
+        void add(const std::string& name) {
+            names.insert(name);
+            //names only differing in case: the lexicographically smallest wins, independent of the listing order
+            auto inserted = lowerCaseNames.insert(std::make_pair(toLower(name), name));
+            if (!inserted.second && name < inserted.first->second)
+                inserted.first->second = name;
+        }
+    };
     std::map<std::string, FileDescriptorP> m_files;
+    std::map<std::string, FileDescriptorP> m_filesByPath;
+    std::map<std::string, DirectoryIndex> m_directories;
+    // file read in the background after prefetchFile
+    struct PendingRead {
+        std::string fullPath;
+        std::shared_future<bool> done;
+        std::shared_ptr<std::vector<unsigned char>> content;
+    };
+    std::set<std::string> m_notFound;
+    std::map<std::string, PendingRead> m_pendingReads;
+    std::vector<std::string> m_dependencies;
     std::vector<std::string> m_searchPath;
+    ThreadPool m_ioPool;
 public:
     explicit DefaultFileHandler(const std::vector<std::string>& searchPath):m_searchPath(searchPath) {
     }
     virtual ~DefaultFileHandler() {
     }
     virtual FileDescriptorP findFile(const std::string& fileName, FileType fileType, FileDescriptorP parent, const SourcePosition& includedInPosition) {
-        std::string modFileName = fileName;
-        if (fileType == SpinFile) {
-            if (modFileName.size()<5 || modFileName.substr(modFileName.size()-5) != ".spin")
-                modFileName += ".spin";
-        }
+        const std::string modFileName = fileNameWithExtension(fileName, fileType);
         auto entry = m_files.find(modFileName);
         if (entry != m_files.end())
             return entry->second;
+        if (m_notFound.find(modFileName) != m_notFound.end())
+            throw CompilerError(ErrorType::fnf, includedInPosition, modFileName);
 
         if (fileType == RootSpinFile) {
-            std::ifstream fs(modFileName, std::ios_base::in | std::ios_base::binary);
-            if (!fs)
+            std::vector<unsigned char> buffer;
+            if (!readFile(modFileName, buffer))
                 throw CompilerError(ErrorType::fnf, includedInPosition, modFileName);
-            return readFile(fs, modFileName);
+            return addFile(modFileName, modFileName, buffer);
+        }
+
+        auto pending = m_pendingReads.find(modFileName);
+        if (pending != m_pendingReads.end()) {
+            const PendingRead read = pending->second;
+            m_pendingReads.erase(pending);
+            auto byPath = m_filesByPath.find(read.fullPath);
+            if (byPath != m_filesByPath.end())
+                return m_files[modFileName] = byPath->second;
+            if (read.done.get())
+                return addFile(modFileName, read.fullPath, *read.content);
         }
 
         for (auto path:m_searchPath) {
-            std::ifstream fs(path+modFileName, std::ios_base::in | std::ios_base::binary);
-            if (fs)
-                return readFile(fs, modFileName);
+            std::string fullPath;
+            if (!resolveInDirectory(path, modFileName, fullPath))
+                continue;
+            auto byPath = m_filesByPath.find(fullPath);
+            if (byPath != m_filesByPath.end()) //the same file requested by a differently spelled name shares one descriptor
+                return m_files[modFileName] = byPath->second;
+            std::vector<unsigned char> buffer;
+            if (readFile(fullPath, buffer))
+                return addFile(modFileName, fullPath, buffer);
         }
+        m_notFound.insert(modFileName);
         throw CompilerError(ErrorType::fnf, includedInPosition, modFileName);
     }
+    //false if findFile will not find the file, answered from the directory listings without reading the file
+    bool hasFile(const std::string& fileName, FileType fileType) {
+        const std::string modFileName = fileNameWithExtension(fileName, fileType);
+        if (m_files.find(modFileName) != m_files.end() || m_pendingReads.find(modFileName) != m_pendingReads.end())
+            return true;
+        if (fileType == RootSpinFile) //not searched
+            return true;
+        if (m_notFound.find(modFileName) != m_notFound.end())
+            return false;
+        std::string fullPath;
+        for (auto path:m_searchPath)
+            if (resolveInDirectory(path, modFileName, fullPath))
+                return true;
+        return false;
+    }
+    virtual std::vector<std::string> dependencies() const {
+        return m_dependencies;
+    }
+    virtual void prefetchFile(const std::string& fileName, FileType fileType) {
+        const std::string modFileName = fileNameWithExtension(fileName, fileType);
+        if (fileType == RootSpinFile || m_files.find(modFileName) != m_files.end() || m_notFound.find(modFileName) != m_notFound.end() || m_pendingReads.find(modFileName) != m_pendingReads.end())
+            return;
+        for (auto path:m_searchPath) {
+            std::string fullPath;
+            if (!resolveInDirectory(path, modFileName, fullPath))
+                continue;
+            if (m_filesByPath.find(fullPath) != m_filesByPath.end())
+                return;
+            PendingRead read;
+            read.fullPath = fullPath;
+            read.content = std::make_shared<std::vector<unsigned char>>();
+            auto content = read.content;
+            read.done = m_ioPool.submit([fullPath, content]() { return readFile(fullPath, *content); }).share();
+            m_pendingReads[modFileName] = read;
+            return;
+        }
+    }
 private:
-    FileDescriptorP readFile(std::ifstream& fs, const std::string& fileName) {
+    static std::string toLower(const std::string& str) {
+        std::string result = str;
+        for (auto& c:result)
+            c = std::tolower((unsigned char)c);
+        return result;
+    }
+    static void listDirectory(const std::string& directory, DirectoryIndex& index) {
+#ifdef _WIN32
+        WIN32_FIND_DATAA findData;
+        HANDLE handle = FindFirstFileA((directory.empty() ? std::string("*") : directory+"*").c_str(), &findData);
+        if (handle == INVALID_HANDLE_VALUE)
+            return;
+        do {
+            index.add(findData.cFileName);
+        } while (FindNextFileA(handle, &findData));
+        FindClose(handle);
+#else
+        DIR* dir = opendir(directory.empty() ? "." : directory.c_str());
+        if (!dir)
+            return;
+        while (struct dirent* dirEntry = readdir(dir))
+            index.add(dirEntry->d_name);
+        closedir(dir);
+#endif
+        index.listed = true;
+    }
+    //returns false if the file is known to be absent in the directory, without touching the file system again
+    bool resolveInDirectory(const std::string& searchPath, const std::string& fileName, std::string& fullPath) {
+        std::string directory = searchPath;
+        std::string name = fileName;
+        for (int i=int(fileName.size())-1; i>=0; --i) {
+            if (fileName[i] == '/' || fileName[i] == '\\') {
+                directory += fileName.substr(0, i+1);
+                name = fileName.substr(i+1);
+                break;
+            }
+        }
+        auto dirIt = m_directories.find(directory);
+        if (dirIt == m_directories.end()) {
+            dirIt = m_directories.insert(std::make_pair(directory, DirectoryIndex())).first;
+            listDirectory(directory, dirIt->second);
+        }
+        const DirectoryIndex& index = dirIt->second;
+        if (!index.listed) {
+            fullPath = directory+name;
+            return true;
+        }
+        //an exact match wins over a name only differing in case
+        if (index.names.find(name) != index.names.end()) {
+            fullPath = directory+name;
+            return true;
+        }
+        auto nameIt = index.lowerCaseNames.find(toLower(name));
+        if (nameIt == index.lowerCaseNames.end())
+            return false;
+        fullPath = directory+nameIt->second;
+        return true;
+    }
+    static bool readFile(const std::string& fullPath, std::vector<unsigned char>& buffer) {
+        std::ifstream fs(fullPath, std::ios_base::in | std::ios_base::binary);
+        if (!fs)
+            return false;
         fs.seekg(0,std::ios::end);
         auto length = fs.tellg();
         fs.seekg(0,std::ios::beg);
         //TODO file too large error
-        std::vector<unsigned char> buffer(length);
+        buffer.resize(length);
         fs.read(reinterpret_cast<char*>(buffer.data()),length);
-
+        return true;
+    }
+    FileDescriptorP addFile(const std::string& fileName, const std::string& fullPath, const std::vector<unsigned char>& buffer) {
         FileDescriptorP newFileDesc(new FileDescriptor(buffer, fileName));
         m_files[fileName] = newFileDesc;
+        m_filesByPath[fullPath] = newFileDesc;
+        m_dependencies.push_back(fullPath);
         return newFileDesc;
     }
 };
@@ -0,0 +1,311 @@
+//////////////////////////////////////////////////////////////
+//                                                          //
+// Propeller Spin/PASM Compiler                             //
+// (c)2012-2016 Parallax Inc. DBA Parallax Semiconductor.   //
+// Adapted from Chip Gracey's x86 asm code by Roy Eltham    //
+// Rewritten to modern C++ by Thilo Ackermann               //
+// See end of file for terms of use.                        //
+//                                                          //
+////////////////////////////////////////////////////////////// 
+
+#ifndef SPINCOMPILER_LIBRARYPACK_H
+#define SPINCOMPILER_LIBRARYPACK_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <cctype>
+#include <cstdint>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * A library pack bundles all files of a library directory into one file, so they can be served without opening each file.
+ * All numbers are 32 bit little endian.
+ *
+ *   header    "SPAK", version, entry count, slot count (power of two)
+ *   slots     slot count times: hash of lower case name, entry index+1 (0 marks an empty slot)
+ *   entries   entry count times: name offset, name size, data offset, data size (offsets relative to the begin of the pack)
+ *   names     file names relative to the packed directory, '/' separates sub directories
+ *   data      file contents
+ *
+ * Names are looked up by open addressing with linear probing, the comparison is case insensitive.
+ */
+
+typedef std::shared_ptr<class LibraryPack> LibraryPackP;
+class LibraryPack {
+public:
+    static const int Version = 1;
+    static const int HeaderSize = 16;
+    static const int SlotSize = 8;
+    static const int EntrySize = 16;
+    static const uint64_t MaxPackSize = 0xFFFFFFFFu; //all offsets and sizes are 32 bit
+
+    ~LibraryPack() {
+#ifndef _WIN32
+        if (m_mapped)
+            munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+    }
+    LibraryPack(const LibraryPack&) = delete;
+    LibraryPack& operator=(const LibraryPack&) = delete;
+
+    const std::string fileName;
+
+    //returns nullptr if the file is not a valid library pack
+    static LibraryPackP open(const std::string& fileName) {
+        LibraryPackP pack(new LibraryPack(fileName));
+        if (!pack->map() || !pack->validate())
+            return LibraryPackP();
+        return pack;
+    }
+
+    static bool isLibraryPack(const std::string& fileName) {
+        std::ifstream fs(fileName, std::ios_base::in | std::ios_base::binary);
+        char magic[4] = {0,0,0,0};
+        return fs && fs.read(magic,4) && std::equal(magic, magic+4, "SPAK");
+    }
+
+    bool find(const std::string& name, const unsigned char*& data, unsigned int& size) const {
+        const std::string normalized = normalizeName(name);
+        const uint32_t hash = hashName(normalized);
+        const uint32_t mask = m_slotCount-1;
+        for (uint32_t slot = hash & mask;; slot = (slot+1) & mask) {
+            const unsigned char* slotPtr = m_data+HeaderSize+slot*SlotSize;
+            const uint32_t entryIndex = readInt(slotPtr+4);
+            if (entryIndex == 0)
+                return false;
+            if (readInt(slotPtr) != hash)
+                continue;
+            const unsigned char* entryPtr = m_data+HeaderSize+m_slotCount*SlotSize+(entryIndex-1)*EntrySize;
+            const uint32_t nameSize = readInt(entryPtr+4);
+            if (nameSize != normalized.size() || !std::equal(normalized.begin(), normalized.end(), m_data+readInt(entryPtr), [](char a, unsigned char b) { return a == char(std::tolower(b)); }))
+                continue;
+            data = m_data+readInt(entryPtr+8);
+            size = readInt(entryPtr+12);
+            return true;
+        }
+    }
+
+    //packs all files below directory into packFileName, returns an error message or an empty string on success
+    static std::string create(const std::string& directory, const std::string& packFileName) {
+        const std::string baseDirectory = directory.empty() || directory.back() == '/' || directory.back() == '\\' ? directory : directory+"/";
+        std::vector<std::string> names;
+        if (!listFilesRecursive(baseDirectory, std::string(), names))
+            return "unable to read directory '"+directory+"'";
+        std::sort(names.begin(), names.end());
+        if (uint64_t(names.size())*(EntrySize+2*SlotSize) > MaxPackSize)
+            return "too many files for a library pack";
+
+        uint32_t slotCount = 1;
+        while (slotCount < 2*names.size()+1)
+            slotCount <<= 1;
+        std::vector<unsigned char> slots(slotCount*SlotSize, 0);
+        std::vector<unsigned char> entries;
+        std::vector<unsigned char> nameData;
+        std::vector<unsigned char> fileData;
+        std::set<std::string> packedNames;
+        const uint64_t tableSize = HeaderSize+slots.size()+uint64_t(names.size())*EntrySize;
+        for (const auto& name:names) {
+            const std::string normalized = normalizeName(name);
+            if (!packedNames.insert(normalized).second)
+                continue; //only differs in case from an already packed file
+            std::ifstream fs(baseDirectory+name, std::ios_base::in | std::ios_base::binary);
+            if (!fs)
+                return "unable to read file '"+name+"'";
+            std::vector<unsigned char> content((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+            if (tableSize+nameData.size()+name.size()+fileData.size()+content.size() > MaxPackSize)
+                return "library pack would exceed 4 GiB";
+            const uint32_t entryIndex = packedNames.size()-1;
+
+            const uint32_t hash = hashName(normalized);
+            uint32_t slot = hash & (slotCount-1);
+            while (readInt(&slots[slot*SlotSize+4]) != 0)
+                slot = (slot+1) & (slotCount-1);
+            writeInt(&slots[slot*SlotSize], hash);
+            writeInt(&slots[slot*SlotSize+4], entryIndex+1);
+
+            appendInt(entries, nameData.size()); //relative offsets, fixed up below
+            appendInt(entries, name.size());
+            appendInt(entries, fileData.size());
+            appendInt(entries, content.size());
+            nameData.insert(nameData.end(), name.begin(), name.end());
+            fileData.insert(fileData.end(), content.begin(), content.end());
+        }
+        const uint32_t namesOffset = HeaderSize+slots.size()+entries.size();
+        const uint32_t dataOffset = namesOffset+nameData.size();
+        for (unsigned int i=0; i<entries.size(); i+=EntrySize) {
+            writeInt(&entries[i], readInt(&entries[i])+namesOffset);
+            writeInt(&entries[i+8], readInt(&entries[i+8])+dataOffset);
+        }
+
+        std::vector<unsigned char> header = {'S','P','A','K'};
+        appendInt(header, Version);
+        appendInt(header, packedNames.size());
+        appendInt(header, slotCount);
+        std::ofstream outFile(packFileName, std::ios::out | std::ios::binary);
+        for (const auto* part: {&header, &slots, &entries, &nameData, &fileData})
+            outFile.write(reinterpret_cast<const char*>(part->data()), part->size());
+        if (!outFile)
+            return "unable to write '"+packFileName+"'";
+        return std::string();
+    }
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<unsigned char> m_buffer; //used if the file could not be mapped
+    uint32_t m_slotCount;
+
+    explicit LibraryPack(const std::string& fileName):fileName(fileName),m_data(nullptr),m_size(0),m_mapped(false),m_slotCount(0) {}
+
+    bool map() {
+#ifndef _WIN32
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED) {
+                m_data = static_cast<const unsigned char*>(ptr);
+                m_size = st.st_size;
+                m_mapped = true;
+            }
+        }
+        ::close(fd);
+        if (m_mapped)
+            return true;
+#endif
+        std::ifstream fs(fileName, std::ios_base::in | std::ios_base::binary);
+        if (!fs)
+            return false;
+        m_buffer.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+        return true;
+    }
+
+    //check all offsets once, so find does not need any range checks
+    bool validate() {
+        if (m_size < HeaderSize || !std::equal(m_data, m_data+4, "SPAK") || readInt(m_data+4) != Version)
+            return false;
+        const uint64_t entryCount = readInt(m_data+8);
+        m_slotCount = readInt(m_data+12);
+        if (m_slotCount == 0 || (m_slotCount & (m_slotCount-1)) != 0 || entryCount >= m_slotCount)
+            return false;
+        const uint64_t entriesOffset = HeaderSize+uint64_t(m_slotCount)*SlotSize;
+        if (entriesOffset+entryCount*EntrySize > m_size)
+            return false;
+        bool hasEmptySlot = false;
+        for (uint32_t slot=0; slot<m_slotCount; ++slot) {
+            const uint32_t entryIndex = readInt(m_data+HeaderSize+slot*SlotSize+4);
+            if (entryIndex > entryCount)
+                return false;
+            hasEmptySlot |= entryIndex == 0;
+        }
+        if (!hasEmptySlot) //lookups would never terminate
+            return false;
+        for (uint64_t i=0; i<entryCount; ++i) {
+            const unsigned char* entryPtr = m_data+entriesOffset+i*EntrySize;
+            if (uint64_t(readInt(entryPtr))+readInt(entryPtr+4) > m_size || uint64_t(readInt(entryPtr+8))+readInt(entryPtr+12) > m_size)
+                return false;
+        }
+        return true;
+    }
+
+    static std::string normalizeName(const std::string& name) {
+        std::string result = name;
+        for (auto& c:result)
+            c = c == '\\' ? '/' : std::tolower((unsigned char)c);
+        return result;
+    }
+    static uint32_t hashName(const std::string& normalizedName) { //FNV-1a
+        uint32_t hash = 2166136261u;
+        for (unsigned char c:normalizedName)
+            hash = (hash ^ c) * 16777619u;
+        return hash;
+    }
+    static uint32_t readInt(const unsigned char* ptr) {
+        return uint32_t(ptr[0]) | (uint32_t(ptr[1])<<8) | (uint32_t(ptr[2])<<16) | (uint32_t(ptr[3])<<24);
+    }
+    static void writeInt(unsigned char* ptr, uint32_t value) {
+        for (int i=0; i<4; ++i)
+            ptr[i] = (value >> (8*i)) & 0xFF;
+    }
+    static void appendInt(std::vector<unsigned char>& buffer, uint32_t value) {
+        buffer.resize(buffer.size()+4);
+        writeInt(&buffer[buffer.size()-4], value);
+    }
+
+    static bool listFilesRecursive(const std::string& directory, const std::string& prefix, std::vector<std::string>& result) {
+#ifdef _WIN32
+        WIN32_FIND_DATAA findData;
+        HANDLE handle = FindFirstFileA((directory+prefix+"*").c_str(), &findData);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+        do {
+            const std::string name = findData.cFileName;
+            if (name == "." || name == "..")
+                continue;
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                listFilesRecursive(directory, prefix+name+"/", result);
+            else
+                result.push_back(prefix+name);
+        } while (FindNextFileA(handle, &findData));
+        FindClose(handle);
+#else
+        DIR* dir = opendir((directory+prefix).c_str());
+        if (!dir)
+            return false;
+        while (struct dirent* dirEntry = readdir(dir)) {
+            const std::string name = dirEntry->d_name;
+            if (name == "." || name == "..")
+                continue;
+            struct stat st;
+            if (stat((directory+prefix+name).c_str(), &st) != 0)
+                continue;
+            if (S_ISDIR(st.st_mode))
+                listFilesRecursive(directory, prefix+name+"/", result);
+            else if (S_ISREG(st.st_mode))
+                result.push_back(prefix+name);
+        }
+        closedir(dir);
+#endif
+        return true;
+    }
+};
+
+#endif //SPINCOMPILER_LIBRARYPACK_H
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//                           TERMS OF USE: MIT License                                   //
+///////////////////////////////////////////////////////////////////////////////////////////
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this  //
+// software and associated documentation files (the "Software"), to deal in the Software //
+// without restriction, including without limitation the rights to use, copy, modify,    //
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to    //
+// permit persons to whom the Software is furnished to do so, subject to the following   //
+// conditions:                                                                           //
+//                                                                                       //
+// The above copyright notice and this permission notice shall be included in all copies //
+// or substantial portions of the Software.                                              //
+//                                                                                       //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,   //
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A         //
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT    //
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION     //
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE        //
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                                //
+///////////////////////////////////////////////////////////////////////////////////////////
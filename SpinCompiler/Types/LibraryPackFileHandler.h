@@ -0,0 +1,122 @@
+//////////////////////////////////////////////////////////////
+//                                                          //
+// Propeller Spin/PASM Compiler                             //
+// (c)2012-2016 Parallax Inc. DBA Parallax Semiconductor.   //
+// Adapted from Chip Gracey's x86 asm code by Roy Eltham    //
+// Rewritten to modern C++ by Thilo Ackermann               //
+// See end of file for terms of use.                        //
+//                                                          //
+////////////////////////////////////////////////////////////// 
+
+#ifndef SPINCOMPILER_LIBRARYPACKFILEHANDLER_H
+#define SPINCOMPILER_LIBRARYPACKFILEHANDLER_H
+
+#include "SpinCompiler/Types/AbstractFileHandler.h"
+#include "SpinCompiler/Types/CompilerError.h"
+#include "SpinCompiler/Types/DefaultFileHandler.h"
+#include "SpinCompiler/Types/LibraryPack.h"
+#include <map>
+#include <algorithm>
+
+// Serves files out of library packs and directories, searched in the order given on the command line.
+
+class LibraryPackFileHandler : public AbstractFileHandler {
+public:
+    //either a library pack or a directory
+    struct SearchEntry {
+        explicit SearchEntry(LibraryPackP pack):pack(pack),reportedDependencies(0) {}
+        explicit SearchEntry(const std::string& directory):directory(new DefaultFileHandler(std::vector<std::string>(1, directory))),reportedDependencies(0) {}
+        LibraryPackP pack;
+        std::shared_ptr<DefaultFileHandler> directory;
+        unsigned int reportedDependencies; //of the directory handler, already added to m_dependencies
+    };
+private:
+    std::map<std::string, FileDescriptorP> m_files;
+    std::vector<SearchEntry> m_searchList;
+    std::vector<std::string> m_dependencies;
+    DefaultFileHandler m_rootFiles; //the root file is given by its path, it is not searched
+public:
+    explicit LibraryPackFileHandler(const std::vector<SearchEntry>& searchList):m_searchList(searchList),m_rootFiles(std::vector<std::string>()) {
+    }
+    virtual ~LibraryPackFileHandler() {
+    }
+    virtual FileDescriptorP findFile(const std::string& fileName, FileType fileType, FileDescriptorP parent, const SourcePosition& includedInPosition) {
+        const std::string modFileName = fileNameWithExtension(fileName, fileType);
+        auto entry = m_files.find(modFileName);
+        if (entry != m_files.end())
+            return entry->second;
+        if (fileType == RootSpinFile) {
+            auto file = m_rootFiles.findFile(fileName, fileType, parent, includedInPosition);
+            m_dependencies.push_back(m_rootFiles.dependencies().back());
+            return m_files[modFileName] = file;
+        }
+        for (auto& search:m_searchList) {
+            if (search.pack) {
+                const unsigned char* data = nullptr;
+                unsigned int size = 0;
+                if (!search.pack->find(modFileName, data, size))
+                    continue;
+                if (std::find(m_dependencies.begin(), m_dependencies.end(), search.pack->fileName) == m_dependencies.end())
+                    m_dependencies.push_back(search.pack->fileName);
+                return m_files[modFileName] = FileDescriptorP(new FileDescriptor(std::vector<unsigned char>(data, data+size), modFileName));
+            }
+            if (!search.directory->hasFile(fileName, fileType))
+                continue;
+            try {
+                auto file = search.directory->findFile(fileName, fileType, parent, includedInPosition);
+                const auto dependencies = search.directory->dependencies();
+                for (; search.reportedDependencies<dependencies.size(); ++search.reportedDependencies)
+                    m_dependencies.push_back(dependencies[search.reportedDependencies]);
+                return m_files[modFileName] = file;
+            }
+            catch (const CompilerError& e) {
+                if (e.errType != ErrorType::fnf)
+                    throw;
+            }
+        }
+        throw CompilerError(ErrorType::fnf, includedInPosition, modFileName);
+    }
+    virtual std::vector<std::string> dependencies() const {
+        return m_dependencies;
+    }
+    virtual void prefetchFile(const std::string& fileName, FileType fileType) {
+        if (fileType == RootSpinFile)
+            return;
+        const std::string modFileName = fileNameWithExtension(fileName, fileType);
+        for (auto& search:m_searchList) {
+            if (search.pack) {
+                const unsigned char* data = nullptr;
+                unsigned int size = 0;
+                if (search.pack->find(modFileName, data, size))
+                    return; //already in memory
+            }
+            else if (search.directory->hasFile(fileName, fileType)) {
+                search.directory->prefetchFile(fileName, fileType);
+                return;
+            }
+        }
+    }
+};
+
+#endif //SPINCOMPILER_LIBRARYPACKFILEHANDLER_H
+
+///////////////////////////////////////////////////////////////////////////////////////////
+//                           TERMS OF USE: MIT License                                   //
+///////////////////////////////////////////////////////////////////////////////////////////
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this  //
+// software and associated documentation files (the "Software"), to deal in the Software //
+// without restriction, including without limitation the rights to use, copy, modify,    //
+// merge, publish, distribute, sublicense, and/or sell copies of the Software, and to    //
+// permit persons to whom the Software is furnished to do so, subject to the following   //
+// conditions:                                                                           //
+//                                                                                       //
+// The above copyright notice and this permission notice shall be included in all copies //
+// or substantial portions of the Software.                                              //
+//                                                                                       //
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,   //
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A         //
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT    //
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION     //
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE        //
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                                //
+///////////////////////////////////////////////////////////////////////////////////////////
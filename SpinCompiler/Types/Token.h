@@ -27,6 +27,7 @@ struct BlockType {
         BlockPRI,
         BlockDEV
     };
+    static const int NumberOfTypes = BlockDEV+1;
 };
 
 struct OperatorType {
@@ -366,8 +367,14 @@ struct Token {
 };
 
 struct TokenList {
+    struct BlockRange {
+        BlockRange(TokenIndex begin, TokenIndex end):begin(begin),end(end) {}
+        TokenIndex begin; //index of the block token
+        TokenIndex end; //index of the following block token or end of token list
+    };
     std::vector<Token> tokens;
-    TokenIndex indexOfFirstBlock;
+    std::vector<BlockRange> blocksByType[BlockType::NumberOfTypes]; //ordered by position
+    TokenIndex indexOfLastBlock;
 };
 
 #endif //SPINCOMPILER_TOKEN_H